@@ -0,0 +1,1016 @@
+/*------------------------------------------------------------------*\
+
+       file: batch.c
+      about: derive passwords for many (master, domain) pairs
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+   notes:
+
+   - the input is read in chunks. a chunk ends when it is full or
+     when a new master record starts: all records of a chunk belong
+     to the same master.
+   - a chunk passes through the stages: parse (batch_fill()),
+     normalize, derive and write. batch_run() runs them one after
+     another or, with 'pipeline', concurrently (see pipeline.c).
+   - 'master:' is absorbed only once per master (see sgp_prime()),
+     each domain continues from a copy of that md5Context.
+   - the master is read into sgp.pw, just like in single mode, and
+     is gone after sgp_prime(). the primed md5Context still
+     contains it, so the whole 'struct BATCH' has to be locked and
+     zeroed by the caller.
+
+\*------------------------------------------------------------------*/
+
+#include "batch.h"
+#include "idn.h"
+#include "platform.h"
+#include "probes.h"
+
+#include "djb/byte.h"
+#include "djb/fmt.h"
+#include "djb/str.h"
+
+/*------------------------------------------------------------------*\
+\*------------------------------------------------------------------*/
+
+static void batch_fail(struct BATCH* b, unsigned long line, const char* msg) {
+
+    char err[128];
+    unsigned int n = 0;
+    unsigned int l = str_len(msg);
+
+    byte_copy(err, 17, "error: batch line");
+    n = 17;
+    err[n++] = ' ';
+    n += fmt_ulong(err + n, line);
+    err[n++] = ':';
+    err[n++] = ' ';
+    if (l > sizeof(err) - n - 1) {
+        l = sizeof(err) - n - 1;
+    }
+    byte_copy(err + n, l, msg);
+    err[n + l] = 0;
+
+    byte_zero(b, sizeof(*b));
+    osexit(5, err);
+}
+
+// -uring: copies the next bytes of the input from ring[cur] to 'p'.
+// the read into the other ring buffer is in flight meanwhile, when
+// ring[cur] is used up it becomes ring[cur] and the next read goes
+// to the old one. the syscall which submits it carries the queued
+// write of the output as well.
+static int aio_getbytes(struct BATCH_IO* io, unsigned char* p, size_t max) {
+
+    int n;
+
+    if (io->ring_pos == io->ring_len) {
+        if (io->aio_eof) {
+            return 0;
+        }
+        io->cur ^= 1;
+        n = aio_wait(io->aio + io->cur);
+        if (n < 0) {
+            return -1;
+        }
+        io->ring_pos = 0;
+        io->ring_len = (size_t)n;
+        if (n == 0) {
+            io->aio_eof = 1;
+            return 0;
+        }
+        aio_read(io->fd, io->aio + (io->cur ^ 1), BATCH_IO_SIZE);
+        if (aio_submit() != 0) {
+            return -1;
+        }
+    }
+    n = (int)(io->ring_len - io->ring_pos);
+    if ((size_t)n > max) {
+        n = (int)max;
+    }
+    byte_copy(p, n, io->ring[io->cur] + io->ring_pos);
+    byte_zero(io->ring[io->cur] + io->ring_pos, n); // -verify: the expected passwords
+    io->ring_pos += n;
+    return n;
+}
+
+// returns 1 and the next line (without the '\n') in 'line' and
+// 'len'. returns 0 on eof, -1 on read errors and -2 if the line
+// does not fit into the buffer
+static int io_getline(struct BATCH_IO* io, unsigned char** line, size_t* len) {
+
+    size_t i = io->pos;
+    int n;
+
+    for (;;) {
+        for (; i < io->len; i++) {
+            if (io->buf[i] == '\n') {
+                *line = io->buf + io->pos;
+                *len = i - io->pos;
+                io->pos = i + 1;
+                return 1;
+            }
+        }
+
+        if (io->eof) { // the last line, without a '\n'
+            if (io->pos == io->len) {
+                return 0;
+            }
+            *line = io->buf + io->pos;
+            *len = io->len - io->pos;
+            io->pos = io->len;
+            return 1;
+        }
+
+        // move the partial line to the front and refill
+        if (io->pos > 0) {
+            byte_copy(io->buf, io->len - io->pos, io->buf + io->pos);
+            io->len -= io->pos;
+            i -= io->pos;
+            io->pos = 0;
+        }
+        if (io->len == sizeof(io->buf)) {
+            return -2;
+        }
+
+        if (io->mem) {
+            n = (int)(sizeof(io->buf) - io->len);
+            if ((size_t)n > io->mem_len - io->mem_pos) {
+                n = (int)(io->mem_len - io->mem_pos);
+            }
+            byte_copy(io->buf + io->len, n, io->mem + io->mem_pos);
+            io->mem_pos += n;
+        } else if (io->aio >= 0) {
+            PROBE1(io__wait__start, io->fd);
+            n = aio_getbytes(io, io->buf + io->len, sizeof(io->buf) - io->len);
+            PROBE2(io__wait__end, io->fd, n);
+        } else {
+            PROBE1(io__wait__start, io->fd);
+            n = posix_read(io->fd, io->buf + io->len, sizeof(io->buf) - io->len);
+            PROBE2(io__wait__end, io->fd, n);
+            io->calls++;
+        }
+        if (n < 0) {
+            return -1;
+        }
+        if (n == 0) {
+            io->eof = 1;
+        }
+        io->len += n;
+        io->off += n;
+    }
+}
+
+// writes p[0, len) with write() from 'done' on
+static int io_write(struct BATCH_IO* io, const unsigned char* p, size_t len, size_t done) {
+
+    size_t i;
+    int n;
+
+    for (i = done; i < len; i += n) {
+        PROBE1(io__wait__start, io->fd);
+        n = posix_write(io->fd, p + i, len - i);
+        PROBE2(io__wait__end, io->fd, n);
+        io->calls++;
+        if (n <= 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// -uring: waits for the write of ring[0] and writes what it left out
+static int aio_drain(struct BATCH_IO* io) {
+
+    int n;
+
+    if (!io->busy) {
+        return 0;
+    }
+    io->busy = 0;
+    PROBE1(io__wait__start, io->fd);
+    n = aio_wait(io->aio);
+    PROBE2(io__wait__end, io->fd, n);
+    if (n < 0 || io_write(io, io->ring[0], io->ring_len, (size_t)n) != 0) {
+        return -1;
+    }
+    byte_zero(io->ring[0], io->ring_len);
+    return 0;
+}
+
+static int io_flush(struct BATCH_IO* io) {
+
+    if (io->mem) {
+        if (io->len > io->mem_len - io->mem_pos) {
+            return -1;
+        }
+        byte_copy(io->mem + io->mem_pos, io->len, io->buf);
+        io->mem_pos += io->len;
+    } else if (io->aio >= 0) {
+        // queued only, the next syscall of the ring submits it
+        if (aio_drain(io) != 0) {
+            return -1;
+        }
+        byte_copy(io->ring[0], io->len, io->buf);
+        io->ring_len = io->len;
+        io->busy = 1;
+        aio_write(io->fd, io->aio, io->len);
+    } else if (io_write(io, io->buf, io->len, 0) != 0) {
+        return -1;
+    }
+    io->off += io->len;
+    byte_zero(io->buf, io->len);
+    io->len = 0;
+    return 0;
+}
+
+static void put_le(unsigned char* p, unsigned long long v, size_t n) {
+    size_t i;
+    for (i = 0; i < n; i++, v >>= 8) {
+        p[i] = (unsigned char)v;
+    }
+}
+
+static void io_put(struct BATCH* b, unsigned long line, const unsigned char* p, size_t n) {
+
+    struct BATCH_IO* io = &b->out;
+    if (io->len + n > sizeof(io->buf)) {
+        if (io_flush(io) != 0) {
+            batch_fail(b, line, "can't write output");
+        }
+    }
+    byte_copy(io->buf + io->len, n, p);
+    io->len += n;
+}
+
+/*------------------------------------------------------------------*\
+\*------------------------------------------------------------------*/
+
+// -output=bin: the tag of the current master is md5() of its password
+// for the domain '\n', which no domain of the input contains. a guess
+// of the master costs a whole chain, as much as a guess against any
+// of the passwords in the output.
+static void batch_tag(struct BATCH* b) {
+
+    struct SGP* sgp = &b->sgp;
+    md5Context ctx;
+    unsigned char digest[MD5_DIGEST_LENGTH];
+
+    byte_copy(&sgp->md5, sizeof(sgp->md5), &b->base);
+    sgp->domain = (unsigned char*)"\n";
+    sgp->domain_len = 1;
+    sgp->out_len = B64_MD5_DIGEST_LENGTH;
+    supergenpass_primed(sgp);
+
+    md5_init(&ctx);
+    md5_update(&ctx, sgp->pw, B64_MD5_DIGEST_LENGTH);
+    md5_final(digest, &ctx);
+    byte_copy(b->tag, BIN_TAG_SIZE, digest);
+    b->tag_of = b->tenants;
+
+    byte_zero(sgp->pw, sizeof(sgp->pw));
+    byte_zero(digest, sizeof(digest));
+}
+
+static void batch_master(struct BATCH* b) {
+
+    struct SGP* sgp = &b->sgp;
+
+    if (b->masters && b->tenants >= b->masters_cap) {
+        batch_fail(b, b->line, "too many masters for -procs");
+    }
+
+    // -procs: split() only counts them, see batch_masters()
+    if (b->counting) {
+        b->has_master = 1;
+        b->tenants++;
+        return;
+    }
+
+    // the parent of the -procs workers has read them all already
+    if (b->worker) {
+        byte_copy(&b->base, sizeof(b->base), &b->masters[b->tenants]);
+        b->has_master = 1;
+        b->tenants++;
+        return;
+    }
+
+    sgp->in_len = read_pw(b->master_fd, sgp->pw, sizeof(sgp->pw), 1);
+    sgp_prime(&b->base, sgp->pw, sgp->in_len);
+    byte_zero(sgp->pw, sizeof(sgp->pw));
+
+    if (b->masters) {
+        byte_copy(&b->masters[b->tenants], sizeof(b->base), &b->base);
+    }
+
+    b->has_master = 1;
+    b->tenants++;
+}
+
+void batch_masters(struct BATCH* b, unsigned long n) {
+
+    b->tenants = 0;
+    while (b->tenants < n) {
+        batch_master(b);
+    }
+}
+
+static int is_space(unsigned char c) {
+    return (c == ' ' || c == '\t' || c == '\r');
+}
+
+// -coalesce: 1 if io_getline() would not block: the next line is in
+// the buffer already, the input is in memory or at its end
+static int io_ready(struct BATCH_IO* io) {
+
+    size_t i;
+
+    if (io->mem || io->eof) {
+        return 1;
+    }
+    for (i = io->pos; i < io->len; i++) {
+        if (io->buf[i] == '\n') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// -coalesce: 1 if the chunk should go out as it is instead of waiting
+// for the next record. a chunk which fills the lanes goes out right
+// away. a smaller one waits as long as the missing records take at
+// the observed arrival rate, if that is within the deadline, and not
+// at all otherwise (low load: the latency stays low).
+static int coalesce_done(struct BATCH* b, struct BATCH_CHUNK* c) {
+
+    unsigned long long us;
+
+    if (c->n == 0 || io_ready(&b->in)) {
+        return 0;
+    }
+    if (c->n >= MD5_LANES) {
+        return 1;
+    }
+    us = (b->gap_ns * (MD5_LANES - c->n)) / 1000;
+    if (b->gap_ns == 0 || us > b->coalesce ||
+        posix_wait_read(b->in.fd, (unsigned long)us + 1) == 0) {
+        b->deadlines++;
+        return 1;
+    }
+    return 0;
+}
+
+// -verify: the last column of p[i, n) is the expected password. it
+// goes into the text behind the domain, its bytes in the input buffer
+// are wiped. returns the end of the columns before it.
+static size_t batch_expect(struct BATCH* b, struct BATCH_CHUNK* c, struct BATCH_REC* r,
+    unsigned char* p, size_t i, size_t n) {
+
+    size_t e;
+
+    for (e = n; e > i && !is_space(p[e-1]); e--)
+        ;
+    if (e == n) {
+        batch_fail(b, b->line, "missing the password to verify");
+    }
+    r->exp_off = c->text_len;
+    r->exp_len = n - e;
+    byte_copy(c->text + c->text_len, (r->exp_len < B64_MD5_DIGEST_LENGTH) ?
+        r->exp_len : B64_MD5_DIGEST_LENGTH, p + e);
+    c->text_len += B64_MD5_DIGEST_LENGTH;
+    byte_zero(p + e, n - e);
+
+    // without a length column the password tells the length
+    if (r->exp_len >= MIN_PW_LENGTH && r->exp_len <= B64_MD5_DIGEST_LENGTH) {
+        r->lengths = SGP_LENGTH(r->exp_len);
+    }
+    for (; e > i && is_space(p[e-1]); e--)
+        ;
+    return e;
+}
+
+// adds the domain-record 'p' to chunk 'c'
+static void batch_record(struct BATCH* b, struct BATCH_CHUNK* c,
+    unsigned char* p, size_t n) {
+
+    struct BATCH_REC* r = &c->rec[c->n];
+    size_t i, j;
+
+    for (i = 0; i < n && !is_space(p[i]); i++)
+        ;
+    if (i > MAX_DOMAIN_LENGTH) {
+        batch_fail(b, b->line, "domain too long");
+    }
+
+    r->line = b->line;
+    r->dom_off = c->text_len;
+    r->dom_len = i;
+    r->lengths = b->lengths;
+    byte_copy(c->text + c->text_len, i, p);
+    c->text_len += i;
+
+    // optional: the length(s) of the password
+    for (; i < n && is_space(p[i]); i++)
+        ;
+    if (b->verify) {
+        n = batch_expect(b, c, r, p, i, n);
+    }
+    if (i < n) {
+        for (j = i; j < n && !is_space(p[j]); j++)
+            ;
+        if (j != n || parse_lengths((const char*)p + i, j - i, &r->lengths) == 0) {
+            batch_fail(b, b->line, "length must be >= 4 and <= 24");
+        }
+    }
+    if (b->verify && (r->lengths & (r->lengths - 1)) != 0) {
+        batch_fail(b, b->line, "-verify takes one length per line");
+    }
+
+    r->pw_off = c->pw_len;
+    c->pw_len += sgp_lengths_size(r->lengths);
+    c->n++;
+}
+
+// reads records into 'c' until it is full, a new master starts
+// or the input ends. returns 0 on eof.
+static int fill(struct BATCH* b, struct BATCH_CHUNK* c) {
+
+    unsigned char* p = 0;
+    size_t n = 0;
+    int rc;
+
+    c->n = 0;
+    c->eof = 0;
+    c->text_len = 0;
+    c->pw_len = 0;
+
+    while (c->n < BATCH_RECORDS &&
+           (c->text_len + MAX_DOMAIN_LENGTH + (b->verify ? B64_MD5_DIGEST_LENGTH : 0)) <= BATCH_TEXT &&
+           (c->pw_len + MAX_LENGTHS_SIZE) <= BATCH_PW) {
+
+        if (b->coalesce && coalesce_done(b, c)) {
+            return 1;
+        }
+        rc = io_getline(&b->in, &p, &n);
+        if (rc == 0) {
+            c->eof = 1;
+            return 0;
+        } else if (rc == -1) {
+            batch_fail(b, b->line + 1, "can't read input");
+        } else if (rc == -2) {
+            batch_fail(b, b->line + 1, "line too long");
+        }
+        b->line++;
+
+        for (; n > 0 && is_space(*p); p++, n--)
+            ;
+        for (; n > 0 && is_space(p[n-1]); n--)
+            ;
+        if (n == 0 || *p == '#') {
+            continue;
+        }
+
+        if (*p == '@') {
+            b->next_master++;
+            if (c->n > 0) {
+                return 1;
+            }
+            continue;
+        }
+
+        // the masters are read when they are needed. the masters
+        // of records without domains are skipped, the master-fd
+        // has to stay in step with the master records.
+        if (!b->has_master && b->next_master == 0) {
+            b->next_master = 1;
+        }
+        for (; b->next_master > 0; b->next_master--) {
+            batch_master(b);
+        }
+        if (c->n == 0) {
+            byte_copy(&c->base, sizeof(c->base), &b->base);
+            if (b->output == OUTPUT_BIN && b->tag_of != b->tenants && !b->counting) {
+                batch_tag(b);
+            }
+            byte_copy(c->tag, BIN_TAG_SIZE, b->tag);
+            c->tenant = b->tenants;
+        }
+        batch_record(b, c, p, n);
+
+        // -coalesce: the time between records, averaged
+        if (b->coalesce) {
+            unsigned long long now = posix_now();
+            if (b->last_ns > 0) {
+                b->gap_ns = (b->gap_ns * 7 + (now - b->last_ns)) / 8;
+            }
+            b->last_ns = now;
+        }
+    }
+    return 1;
+}
+
+int batch_fill(struct BATCH* b, struct BATCH_CHUNK* c) {
+
+    int rc = fill(b, c);
+
+    // -checkpoint: everything up to here is in 'c' (or before it)
+    c->end.in_off = b->in.off - (b->in.len - b->in.pos);
+    c->end.line = b->line;
+    c->end.tenants = b->tenants;
+    c->end.next_master = (unsigned long long)b->next_master;
+    return rc;
+}
+
+void batch_normalize(struct BATCH* b, struct BATCH_CHUNK* c) {
+
+    md5Context ctx;
+    unsigned char digest[MD5_DIGEST_LENGTH];
+    size_t i, j, n;
+    size_t idn = c->text_len; // -normalize: the new forms go here
+
+    for (i = 0; i < c->n; i++) {
+        struct BATCH_REC* r = &c->rec[i];
+        if (b->normalize) {
+            idn_host(c->text, &r->dom_off, &r->dom_len);
+        }
+        if (b->normalize && !idn_plain(c->text + r->dom_off, r->dom_len)) {
+            n = idn_normalize(c->text + idn, MAX_DOMAIN_LENGTH, c->text + r->dom_off, r->dom_len);
+            if (n == 0) {
+                batch_fail(b, r->line, "domain is not utf-8 or too long");
+            }
+            r->dom_off = idn;
+            r->dom_len = n;
+            idn += n;
+        }
+        if (r->dom_len == 0) {
+            batch_fail(b, r->line, "empty domain");
+        }
+        if (b->output == OUTPUT_BIN) {
+            md5_init(&ctx);
+            md5_update(&ctx, c->text + r->dom_off, r->dom_len);
+            md5_final(digest, &ctx);
+            for (r->key = 0, j = 8; j > 0; j--) {
+                r->key = (r->key << 8) | digest[j-1];
+            }
+        }
+    }
+}
+
+// -since: takes all passwords of 'r' from the old output, or none
+static int batch_reuse(struct BATCH* b, struct BATCH_CHUNK* c, struct BATCH_REC* r) {
+
+    const unsigned char* pw[B64_MD5_DIGEST_LENGTH + 1];
+    unsigned char fp[BIN_FP_SIZE];
+    size_t l, off, n = 0;
+
+    for (l = MIN_PW_LENGTH; l <= B64_MD5_DIGEST_LENGTH; l++) {
+        if (r->lengths & SGP_LENGTH(l)) {
+            batch_fingerprint(fp, r->key, l, c->tag);
+            pw[l] = since_find(b->since, fp);
+            if (pw[l] == 0) {
+                return 0;
+            }
+            n++;
+        }
+    }
+    for (off = 0, l = MIN_PW_LENGTH; l <= B64_MD5_DIGEST_LENGTH; l++) {
+        if (r->lengths & SGP_LENGTH(l)) {
+            byte_copy(c->pw + r->pw_off + off, l, pw[l]);
+            off += l;
+        }
+    }
+    b->reused += n;
+    return 1;
+}
+
+// -dedup: returns 1 if 'r' gets the passwords of an earlier record,
+// now or after the chunk is derived (c->pw[chunk_off])
+static int batch_dedup(struct BATCH* b, struct BATCH_CHUNK* c, struct BATCH_REC* r,
+    int* n_fresh, int* n_fan) {
+
+    struct DEDUP* d = b->dedup;
+    struct DEDUP_ENTRY* e;
+    int fresh;
+
+    e = dedup_get(d, c->tenant, r->lengths, c->text + r->dom_off, r->dom_len, &fresh);
+    if (e == 0) {
+        return 0;
+    }
+    if (fresh) {
+        e->chunk_off = (unsigned int)r->pw_off;
+        d->fresh[(*n_fresh)++] = e;
+        return 0;
+    }
+    if (e->ready) {
+        byte_copy(c->pw + r->pw_off, sgp_lengths_size(r->lengths), d->pw + e->pw_off);
+    } else {
+        d->fan[*n_fan].dst = r->pw_off;
+        d->fan[*n_fan].src = e->chunk_off;
+        d->fan[*n_fan].len = sgp_lengths_size(r->lengths);
+        (*n_fan)++;
+    }
+    b->deduped++;
+    return 1;
+}
+
+// the records of a chunk share the master, they are derived on
+// MD5_LANES interleaved chains (see supergenpass_lanes())
+void batch_derive(struct BATCH* b, struct BATCH_CHUNK* c) {
+
+    struct DEDUP* d = b->dedup;
+    struct SGP_JOB* job = b->jobs;
+    size_t i;
+    int n, k, n_fresh = 0, n_fan = 0;
+
+    PROBE1(chunk__start, c->n);
+    for (n = 0, i = 0; i < c->n; i++) {
+        struct BATCH_REC* r = &c->rec[i];
+        if (b->since && batch_reuse(b, c, r)) {
+            continue;
+        }
+        if (d && batch_dedup(b, c, r, &n_fresh, &n_fan)) {
+            continue;
+        }
+        job[n].domain = c->text + r->dom_off;
+        job[n].domain_len = r->dom_len;
+        job[n].lengths = r->lengths;
+        job[n].out = c->pw + r->pw_off;
+        n++;
+    }
+    if (n > 0) {
+        supergenpass_lanes(&b->lanes, &c->base, job, n);
+    }
+
+    for (k = 0; k < n_fresh; k++) {
+        struct DEDUP_ENTRY* e = d->fresh[k];
+        byte_copy(d->pw + e->pw_off, sgp_lengths_size(e->lengths), c->pw + e->chunk_off);
+        e->ready = 1;
+    }
+    for (k = 0; k < n_fan; k++) {
+        byte_copy(c->pw + d->fan[k].dst, d->fan[k].len, c->pw + d->fan[k].src);
+    }
+    PROBE1(chunk__end, c->n);
+}
+
+static void write_bin(struct BATCH* b, struct BATCH_CHUNK* c, struct BATCH_REC* r) {
+
+    unsigned char rec[BIN_RECORD_SIZE];
+    size_t l, off;
+
+    for (off = 0, l = MIN_PW_LENGTH; l <= B64_MD5_DIGEST_LENGTH; l++) {
+        if (r->lengths & SGP_LENGTH(l)) {
+            byte_zero(rec, sizeof(rec));
+            batch_fingerprint(rec, r->key, l, c->tag);
+            byte_copy(rec + BIN_FP_SIZE, l, c->pw + r->pw_off + off);
+            io_put(b, r->line, rec, sizeof(rec));
+            off += l;
+
+            b->records++;
+            if (b->flush_every > 0 && (b->records % b->flush_every) == 0) {
+                if (io_flush(&b->out) != 0 || (b->out.aio >= 0 && aio_submit() != 0)) {
+                    batch_fail(b, r->line, "can't write output");
+                }
+            }
+        }
+    }
+    byte_zero(rec, sizeof(rec));
+}
+
+// -verify: compares the password of 'r' with the expected one in
+// constant time and wipes the expected one. only a mismatch is
+// written: "<line> <domain>".
+static void write_verify(struct BATCH* b, struct BATCH_CHUNK* c, struct BATCH_REC* r) {
+
+    const unsigned char* pw = c->pw + r->pw_off;
+    unsigned char* exp = c->text + r->exp_off;
+    unsigned char num[FMT_ULONG];
+    unsigned char d = 0;
+    size_t l, k;
+
+    for (l = MIN_PW_LENGTH; !(r->lengths & SGP_LENGTH(l)); l++)
+        ;
+    d = (r->exp_len != l);
+    for (k = 0; k < l; k++) {
+        d |= pw[k] ^ exp[k];
+    }
+    byte_zero(exp, B64_MD5_DIGEST_LENGTH);
+
+    if (d != 0) {
+        b->mismatches++;
+        io_put(b, r->line, num, fmt_ulong((char*)num, r->line));
+        io_put(b, r->line, (unsigned char*)" ", 1);
+        io_put(b, r->line, c->text + r->dom_off, r->dom_len);
+        io_put(b, r->line, (unsigned char*)"\n", 1);
+    }
+}
+
+// -checkpoint: the output up to the end of 'c' goes to disk before
+// the checkpoint which says so, see checkpoint.c
+static void batch_checkpoint(struct BATCH* b, struct BATCH_CHUNK* c) {
+
+    struct CHECKPOINT ck;
+
+    if (io_flush(&b->out) != 0 || aio_drain(&b->out) != 0 || posix_fsync(b->out.fd) != 0) {
+        batch_fail(b, b->line, "can't write and fsync output for -checkpoint");
+    }
+    byte_copy(&ck, sizeof(ck), &c->end);
+    ck.out_len = b->out.off;
+    ck.records = b->records;
+    ck.mismatches = b->mismatches;
+    ck.options = batch_options(b);
+    if (checkpoint_save(&ck, b->checkpoint) != 0) {
+        batch_fail(b, b->line, "can't write checkpoint");
+    }
+    b->checkpoints++;
+}
+
+void batch_write(struct BATCH* b, struct BATCH_CHUNK* c) {
+
+    size_t i, l, off;
+
+    for (i = 0; i < c->n; i++) {
+        struct BATCH_REC* r = &c->rec[i];
+        if (b->verify) {
+            write_verify(b, c, r);
+            continue;
+        }
+        if (b->output == OUTPUT_BIN) {
+            write_bin(b, c, r);
+            continue;
+        }
+        for (off = 0, l = MIN_PW_LENGTH; l <= B64_MD5_DIGEST_LENGTH; l++) {
+            if (r->lengths & SGP_LENGTH(l)) {
+                if (off > 0) {
+                    io_put(b, r->line, (unsigned char*)" ", 1);
+                }
+                io_put(b, r->line, c->pw + r->pw_off + off, l);
+                off += l;
+            }
+        }
+        io_put(b, r->line, (unsigned char*)"\n", 1);
+    }
+    byte_zero(c->pw, c->pw_len);
+    b->derived += c->n;
+
+    // -coalesce: the records of a chunk are answered with it
+    if (b->coalesce && io_flush(&b->out) != 0) {
+        batch_fail(b, b->line, "can't write output");
+    }
+
+    // one clock read per chunk, one fsync per interval
+    if (b->checkpoint && c->n > 0) {
+        unsigned long long now = posix_now();
+        if (now - b->checkpoint_at >= b->checkpoint_ns) {
+            batch_checkpoint(b, c);
+            b->checkpoint_at = now;
+        }
+    }
+}
+
+static void bin_header(unsigned char h[BIN_HEADER_SIZE], int flags, unsigned long long count) {
+    byte_zero(h, BIN_HEADER_SIZE);
+    byte_copy(h, 4, "CSGP");
+    h[4] = BIN_VERSION;
+    h[5] = BIN_RECORD_SIZE;
+    put_le(h + 6, flags, 2);
+    put_le(h + 8, count, 8);
+}
+
+void batch_fingerprint(unsigned char fp[BIN_FP_SIZE], unsigned long long key,
+    size_t length, const unsigned char tag[BIN_TAG_SIZE]) {
+
+    put_le(fp, key, 8);
+    fp[8] = (unsigned char)length;
+    fp[9] = BIN_METHOD_MD5;
+    byte_copy(fp + 10, BIN_TAG_SIZE, tag);
+}
+
+size_t batch_out_size(struct BATCH* b, struct BATCH_REC* r) {
+
+    size_t l, n = 0;
+
+    for (l = MIN_PW_LENGTH; l <= B64_MD5_DIGEST_LENGTH; l++) {
+        if (r->lengths & SGP_LENGTH(l)) {
+            n += (b->output == OUTPUT_BIN) ? BIN_RECORD_SIZE : l + 1;
+        }
+    }
+    return n;
+}
+
+void batch_flush(struct BATCH* b) {
+
+    unsigned char h[BIN_HEADER_SIZE];
+
+    if (io_flush(&b->out) != 0 || aio_drain(&b->out) != 0) {
+        batch_fail(b, b->line, "can't write output");
+    }
+
+    // a file gets the final count, a pipe stays a stream
+    if (b->output == OUTPUT_BIN && !b->worker && posix_seek(b->out.fd, 0) == 0) {
+        bin_header(h, 0, b->records);
+        if (posix_write(b->out.fd, h, sizeof(h)) != sizeof(h)) {
+            batch_fail(b, b->line, "can't write output");
+        }
+    }
+}
+
+void batch_stats(struct BATCH* b, unsigned long long wall) {
+
+    static const char* names[BATCH_STAGES] = {
+        "parse", "normalize", "derive", "write"
+    };
+    char buf[64];
+    unsigned int n, s;
+    unsigned long long pct;
+
+    for (s = 0; s < BATCH_STAGES; s++) {
+        pct = wall > 0 ? (b->busy[s] * 1000) / wall : 0;
+        n = str_len(names[s]);
+        byte_copy(buf, n, names[s]);
+        buf[n++] = ' ';
+        n += fmt_ulong(buf + n, (unsigned long)(pct / 10));
+        buf[n++] = '.';
+        n += fmt_ulong(buf + n, (unsigned long)(pct % 10));
+        buf[n++] = '%';
+        buf[n++] = '\n';
+        posix_write(2, buf, n);
+    }
+    // lane-blocks of md5_transform_lanes() which hashed a chain
+    if (b->lanes.steps > 0) {
+        pct = (b->lanes.used * 1000) / (b->lanes.steps * MD5_LANES);
+        byte_copy(buf, 6, "lanes ");
+        n = 6 + fmt_ulong(buf + 6, (unsigned long)(pct / 10));
+        buf[n++] = '.';
+        n += fmt_ulong(buf + n, (unsigned long)(pct % 10));
+        buf[n++] = '%';
+        buf[n++] = '\n';
+        posix_write(2, buf, n);
+    }
+    if (b->coalesce) {
+        byte_copy(buf, 9, "deadline ");
+        n = 9 + fmt_ulong(buf + 9, b->deadlines);
+        buf[n++] = '\n';
+        posix_write(2, buf, n);
+    }
+    // read() and write() or io_uring_enter()
+    if (b->in.calls + b->out.calls > 0) {
+        byte_copy(buf, 9, "syscalls ");
+        n = 9 + fmt_ulong(buf + 9, b->in.calls + b->out.calls);
+        if (b->out.aio >= 0) {
+            byte_copy(buf + n, 9, " io_uring");
+            n += 9;
+        }
+        buf[n++] = '\n';
+        posix_write(2, buf, n);
+    }
+    if (b->checkpoint) {
+        byte_copy(buf, 12, "checkpoints ");
+        n = 12 + fmt_ulong(buf + 12, b->checkpoints);
+        buf[n++] = '\n';
+        posix_write(2, buf, n);
+    }
+    if (b->verify) {
+        byte_copy(buf, 11, "mismatches ");
+        n = 11 + fmt_ulong(buf + 11, b->mismatches);
+        buf[n++] = '\n';
+        posix_write(2, buf, n);
+    }
+    if (b->dedup) {
+        byte_copy(buf, 6, "dedup ");
+        n = 6 + fmt_ulong(buf + 6, b->deduped);
+        buf[n++] = '\n';
+        posix_write(2, buf, n);
+    }
+    if (b->since) {
+        byte_copy(buf, 7, "reused ");
+        n = 7 + fmt_ulong(buf + 7, b->reused);
+        buf[n++] = '\n';
+        posix_write(2, buf, n);
+    }
+}
+
+/*------------------------------------------------------------------*\
+\*------------------------------------------------------------------*/
+
+void batch_init(struct BATCH* b, int in_fd, int out_fd, int master_fd, unsigned int lengths) {
+
+    byte_zero(b, sizeof(*b));
+    b->in.fd = in_fd;
+    b->in.aio = -1;
+    b->out.fd = out_fd;
+    b->out.aio = -1;
+    b->master_fd = master_fd;
+    b->lengths = lengths;
+}
+
+// -uring: the input (unless it is mapped) and the output go through
+// aio_*(), on the ring buffers of 'b' which the caller has locked.
+// without io_uring they stay with read() and write().
+static void batch_uring(struct BATCH* b) {
+
+    unsigned char* buf[3];
+
+    buf[0] = b->in.ring[0];
+    buf[1] = b->in.ring[1];
+    buf[2] = b->out.ring[0];
+    if (aio_open(buf, BATCH_IO_SIZE, 3) != 0) {
+        return;
+    }
+    b->out.aio = 2;
+    if (!b->in.mem) {
+        b->in.aio = 0;
+        b->in.cur = 1;
+        aio_read(b->in.fd, 0, BATCH_IO_SIZE);
+    }
+}
+
+unsigned long long batch_options(struct BATCH* b) {
+    return (unsigned long long)b->lengths |
+        ((unsigned long long)(b->output == OUTPUT_BIN) << 32) |
+        ((unsigned long long)(b->verify != 0) << 33) |
+        ((unsigned long long)(b->normalize != 0) << 34);
+}
+
+void batch_resume(struct BATCH* b, const struct CHECKPOINT* ck) {
+
+    unsigned long long k;
+
+    if (ck->options != batch_options(b)) {
+        batch_fail(b, (unsigned long)ck->line, "-resume needs the options of the checkpoint");
+    }
+    if (posix_seek(b->in.fd, ck->in_off) != 0) {
+        batch_fail(b, (unsigned long)ck->line, "can't seek the input to the checkpoint");
+    }
+    if (posix_truncate(b->out.fd, ck->out_len) != 0) {
+        batch_fail(b, (unsigned long)ck->line, "the output is no file or shorter than the checkpoint");
+    }
+    b->in.off = ck->in_off;
+    b->out.off = ck->out_len;
+    b->line = (unsigned long)ck->line;
+    b->records = ck->records;
+    b->mismatches = (unsigned long)ck->mismatches;
+
+    // the master-fd has to be where it was
+    for (k = 0; k < ck->tenants; k++) {
+        batch_master(b);
+    }
+    b->next_master = (int)ck->next_master;
+}
+
+unsigned long batch_run(struct BATCH* b) {
+
+    struct BATCH_CHUNK* c = &b->chunk;
+    unsigned long long start = posix_now();
+    unsigned long long t[BATCH_STAGES + 1];
+
+    b->checkpoint_at = start;
+
+    // a resumed output has its header already
+    if (b->output == OUTPUT_BIN && !b->worker && b->out.off == 0) {
+        unsigned char h[BIN_HEADER_SIZE];
+        bin_header(h, BIN_FLAG_STREAM, 0);
+        io_put(b, 0, h, sizeof(h));
+    }
+
+    if (b->procs > 1 && !b->worker && batch_procs(b) >= 0) {
+        return b->derived;
+    }
+    if (b->pipeline && batch_pipeline(b) >= 0) {
+        return b->derived;
+    }
+
+    // one ring, one thread: not with -pipeline. -coalesce looks at
+    // the fd itself.
+    if (b->uring && !b->coalesce) {
+        batch_uring(b);
+    }
+
+    do {
+        t[BATCH_PARSE] = posix_now();
+        batch_fill(b, c);
+        t[BATCH_NORMALIZE] = posix_now();
+        batch_normalize(b, c);
+        t[BATCH_DERIVE] = posix_now();
+        batch_derive(b, c);
+        t[BATCH_WRITE] = posix_now();
+        batch_write(b, c);
+        t[BATCH_STAGES] = posix_now();
+
+        b->busy[BATCH_PARSE] += t[BATCH_NORMALIZE] - t[BATCH_PARSE];
+        b->busy[BATCH_NORMALIZE] += t[BATCH_DERIVE] - t[BATCH_NORMALIZE];
+        b->busy[BATCH_DERIVE] += t[BATCH_WRITE] - t[BATCH_DERIVE];
+        b->busy[BATCH_WRITE] += t[BATCH_STAGES] - t[BATCH_WRITE];
+    } while (!c->eof);
+
+    batch_flush(b);
+    if (b->out.aio >= 0) {
+        b->out.calls += aio_syscalls();
+        aio_close();
+    }
+
+    if (b->stats && !b->worker) {
+        batch_stats(b, posix_now() - start);
+    }
+    return b->derived;
+}
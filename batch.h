@@ -0,0 +1,340 @@
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+/*------------------------------------------------------------------*\
+
+       file: batch.h
+      about: derive passwords for many (master, domain) pairs
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+   the batch input is line based:
+
+     # a comment, ignored as are empty lines
+     @alice              <- a master record: the next master is read
+     example.com            from the master-fd. the label is ignored.
+     github.io 16        <- a domain with an explicit length, "8,16"
+                            or "8-12" create several passwords
+     @bob
+     example.com
+
+   domains before the first master record use the first master of
+   the master-fd. every domain produces one line of output, in the
+   order of the input. several passwords of one domain are separated
+   by ' ', shortest first. the masters never pass through the batch
+   input, they come from their own fd.
+
+   with -output=bin the output is a 16 byte header followed by 40 byte
+   records, one per (domain, length), all integers little endian:
+
+     header:  0  "CSGP"
+              4  u8  version (2)
+              5  u8  record size (40)
+              6  u16 flags: 1 = stream, 'count' is not known
+              8  u64 count of records
+     record:  0  u64 key: the first 8 bytes of md5(domain)
+              8  u8  length of the password
+              9  u8  method (0 = md5)
+             10  6 bytes tag of the master: md5(the password of
+                 the domain '\n' and length 24)
+             16  24 bytes password, zero padded
+
+   with -verify every line ends with the password to check, the
+   length column is optional then, the password tells the length:
+
+     example.com dlHhFkN3vr
+     github.io 16 j78DM1hKP9xxxxxx
+
+   only mismatches are written, "<line> <domain>" per line.
+
+   the header is rewritten with the final count if the output is
+   seekable. every write() contains whole records only.
+
+   with -checkpoint=file the state of the run is written to 'file'
+   every -checkpoint-every seconds, one line of decimal numbers:
+
+     csgp-checkpoint 1 <input> <output> <line> <masters> <pending>
+       <records> <mismatches> <options>
+
+   the bytes of input read and of output written (and fsynced) so far,
+   the line number, the masters read from the master-fd, the master
+   records without a domain yet, the -output=bin records, the -verify
+   mismatches and the options which change the output. -resume
+   continues from there (see batch_resume()). there are no secrets in
+   it.
+
+   the first 16 bytes of a record are its fingerprint. with -since
+   the records of an old output with the same fingerprint are reused
+   instead of derived again (see since.c). the tag tells only if two
+   records belong to the same master. it comes from a whole chain
+   (see batch_tag()), testing a guessed master against it costs as
+   much as testing it against a password. version 1 files had a
+   plain md5() of the master as tag, -since does not take them.
+
+\*------------------------------------------------------------------*/
+
+#include <stddef.h>
+#include "sgp.h"
+
+enum {
+    MAX_DOMAIN_LENGTH = 255,
+    DEFAULT_DEDUP_ENTRIES = 32768,
+    DEFAULT_COALESCE_US   = 500,
+    DEFAULT_CHECKPOINT_SECS = 60,
+    BATCH_RECORDS     = 64,   // records per chunk
+    BATCH_TEXT        = 4096, // bytes of domain-text per chunk
+    BATCH_IDN         = BATCH_RECORDS * MAX_DOMAIN_LENGTH, // -normalize
+    BATCH_PW          = 4096, // bytes of passwords per chunk
+    BATCH_IO_SIZE     = 4096,
+
+    BIN_VERSION       = 2,
+    BIN_HEADER_SIZE   = 16,
+    BIN_RECORD_SIZE   = 40,
+    BIN_FLAG_STREAM   = 1,
+    BIN_METHOD_MD5    = 0,
+    BIN_TAG_SIZE      = 6,
+    BIN_FP_SIZE       = 16,   // the fingerprint of a record
+};
+
+enum {
+    OUTPUT_TEXT = 0,
+    OUTPUT_BIN,
+};
+
+// the stages of the batch engine
+enum {
+    BATCH_PARSE = 0,
+    BATCH_NORMALIZE,
+    BATCH_DERIVE,
+    BATCH_WRITE,
+    BATCH_STAGES,
+};
+
+struct BATCH_REC {
+    unsigned long   line;     // line number in the batch input
+    size_t          dom_off;  // the domain is at chunk.text[dom_off]
+    size_t          dom_len;
+    unsigned long long key;   // -output=bin: see above
+    unsigned int    lengths;  // see SGP_LENGTH()
+    size_t          pw_off;   // the passwords are at chunk.pw[pw_off]
+    size_t          exp_off;  // -verify: the expected one is at chunk.text[exp_off]
+    size_t          exp_len;
+};
+
+// -checkpoint: where a run stands, see above
+struct CHECKPOINT {
+    unsigned long long  in_off;      // bytes of input consumed
+    unsigned long long  out_len;     // bytes of output written
+    unsigned long long  line;
+    unsigned long long  tenants;     // masters read
+    unsigned long long  next_master; // pending master records
+    unsigned long long  records;     // -output=bin
+    unsigned long long  mismatches;  // -verify
+    unsigned long long  options;     // see batch_options()
+};
+
+// a chunk is the unit of work: all its records belong to the
+// same master and thus share the same primed md5Context
+struct BATCH_CHUNK {
+    md5Context          base;     // 'master:', see sgp_prime()
+    unsigned long       tenant;   // the number of the master
+    unsigned char       tag[BIN_TAG_SIZE]; // -output=bin: see above
+    size_t              n;        // records in use
+    int                 eof;      // the last chunk of the input
+    struct CHECKPOINT   end;      // the input side after the chunk
+    size_t              text_len; // bytes of text in use
+    size_t              pw_len;   // bytes of pw in use
+    struct BATCH_REC    rec[BATCH_RECORDS];
+    unsigned char       text[BATCH_TEXT + BATCH_IDN]; // -normalize: after text_len
+    unsigned char       pw[BATCH_PW];
+};
+
+struct BATCH_IO {
+    int             fd;
+    int             eof;
+    size_t          pos;
+    size_t          len;
+    unsigned long long off;   // bytes read into / written from buf
+    unsigned long   calls;    // read() and write() syscalls
+    unsigned char*  mem;      // if set: read from / write to mem[mem_pos],
+    size_t          mem_pos;  // up to mem[mem_len], instead of 'fd'
+    size_t          mem_len;
+    unsigned char   buf[BATCH_IO_SIZE];
+
+    // -uring: buf is copied from / to ring[], the registered buffers
+    // of aio_*(). in: ring[cur] holds the next bytes, the next read
+    // goes to the other one. out: a write of ring[0] is in flight.
+    int             aio;      // the index of ring[0] for aio_*(), -1: off
+    int             cur;
+    int             busy;
+    int             aio_eof;
+    size_t          ring_pos;
+    size_t          ring_len;
+    unsigned char   ring[2][BATCH_IO_SIZE];
+};
+
+// the previous output for -since
+struct SINCE {
+    const unsigned char*    file;
+    size_t                  file_len;
+    unsigned long           n;      // records in 'file'
+    unsigned long*          slot;   // the hash table, see since.c
+    size_t                  slots;
+};
+
+// -dedup: the passwords derived so far, see dedup.c
+struct DEDUP_ENTRY {
+    unsigned long   tenant;   // the master
+    unsigned int    lengths;
+    unsigned int    dom_len;
+    unsigned int    text_off; // the domain is at text[text_off]
+    unsigned int    pw_off;   // the passwords are at pw[pw_off]
+    unsigned int    chunk_off; // derived in this chunk: at chunk.pw[chunk_off]
+    int             ready;    // pw[pw_off] is there
+};
+
+struct DEDUP_FAN {            // a copy within the chunk
+    size_t          dst;
+    size_t          src;
+    size_t          len;
+};
+
+struct DEDUP {
+    unsigned char*          arena;
+    size_t                  arena_len;
+    int                     lock;
+    unsigned long long      seed;   // keys the hash
+    unsigned int*           slot;   // hash tag, entry + 1
+    size_t                  slots;
+    struct DEDUP_ENTRY*     entry;
+    unsigned long           n, cap;
+    unsigned char*          text;
+    size_t                  text_len, text_cap;
+    unsigned char*          pw;
+    size_t                  pw_len, pw_cap;
+
+    // the entries and copies of the current chunk
+    struct DEDUP_ENTRY*     fresh[BATCH_RECORDS];
+    struct DEDUP_FAN        fan[BATCH_RECORDS];
+};
+
+struct BATCH {
+    unsigned int        lengths;     // default lengths of the passwords
+    int                 master_fd;
+    int                 lock;        // lock the memory of other stages
+    int                 pipeline;    // run the stages concurrently
+    int                 stats;       // report the stage utilization
+    int                 output;      // OUTPUT_TEXT or OUTPUT_BIN
+    int                 normalize;   // case folding, punycode (see idn.c)
+    int                 verify;      // compare with the expected passwords
+    unsigned long       mismatches;  // -verify
+    unsigned long       coalesce;    // -coalesce: the deadline in us
+    unsigned long long  gap_ns;      // -coalesce: between records
+    unsigned long long  last_ns;
+    unsigned long       deadlines;   // chunks which did not wait longer
+    unsigned long       flush_every; // flush after n records, 0: when full
+    const char*         checkpoint;  // -checkpoint: the file
+    unsigned long long  checkpoint_ns;  // the interval
+    unsigned long long  checkpoint_at;  // the last one
+    unsigned long       checkpoints;
+    int                 uring;       // -uring: io_uring for the in- and output
+    unsigned long       derived;
+    unsigned long long  records;     // records written
+    unsigned long long  busy[BATCH_STAGES]; // nanoseconds per stage
+    int                 procs;       // -procs: worker processes
+    int                 worker;      // this is one of them
+    md5Context*         masters;     // -procs: all masters, primed
+    int                 counting;    // -procs: count the masters, read none
+    unsigned long       masters_cap;
+    struct SINCE*       since;       // -since: the old output
+    unsigned long       reused;      // passwords taken from 'since'
+    struct DEDUP*       dedup;       // -dedup
+    unsigned long       deduped;     // records copied from 'dedup'
+    int                 has_master;
+    int                 next_master; // pending master records
+    unsigned long       line;
+    unsigned long       tenants;     // number of masters read
+    md5Context          base;        // the current master, primed
+    unsigned char       tag[BIN_TAG_SIZE]; // -output=bin: of 'base'
+    unsigned long       tag_of;      // the master of 'tag', 0: none
+    struct SGP          sgp;         // reading the masters
+    struct SGP_LANES    lanes;       // deriving
+    struct SGP_JOB      jobs[BATCH_RECORDS];
+    struct BATCH_IO     in;
+    struct BATCH_IO     out;
+    struct BATCH_CHUNK  chunk;
+};
+
+extern void batch_init(struct BATCH*, int in_fd, int out_fd, int master_fd, unsigned int lengths);
+
+// derives all records of the batch input. returns the number
+// of derived passwords, exits on errors (after zeroing 'b')
+extern unsigned long batch_run(struct BATCH* b);
+
+// the stages. every stage touches only its own part of 'b' and the
+// given chunk, thus the stages of different chunks can run at the
+// same time. batch_fill() returns 0 after the last chunk.
+extern int  batch_fill(struct BATCH* b, struct BATCH_CHUNK* c);
+extern void batch_normalize(struct BATCH* b, struct BATCH_CHUNK* c);
+extern void batch_derive(struct BATCH* b, struct BATCH_CHUNK* c);
+extern void batch_write(struct BATCH* b, struct BATCH_CHUNK* c);
+extern void batch_flush(struct BATCH* b); // after the last chunk
+
+// prints the utilization of the stages over 'wall' nanoseconds
+extern void batch_stats(struct BATCH* b, unsigned long long wall);
+
+// runs the stages on their own threads, connected by bounded
+// queues (see pipeline.c). returns -1 if csgp was built without
+// threads.
+extern long batch_pipeline(struct BATCH* b);
+
+// -checkpoint: the options of 'b' which change the output. a run is
+// resumed only with the same ones.
+extern unsigned long long batch_options(struct BATCH* b);
+
+// continues the run of checkpoint 'ck': seeks the input, cuts the
+// output to the checkpointed length and reads the masters up to
+// there. exits on errors.
+extern void batch_resume(struct BATCH* b, const struct CHECKPOINT* ck);
+
+// reads / writes (via 'path'.tmp and rename) a checkpoint file, the
+// file is fsynced. -1 on errors or if 'path' is no checkpoint.
+extern int checkpoint_load(struct CHECKPOINT* ck, const char* path);
+extern int checkpoint_save(const struct CHECKPOINT* ck, const char* path);
+
+// -procs: reads the first 'n' masters of the master-fd into
+// b->masters, primed
+extern void batch_masters(struct BATCH* b, unsigned long n);
+
+// splits the input (b->in.mem) into b->procs parts and derives them
+// in worker processes (see procs.c). exits if there is no fork().
+extern long batch_procs(struct BATCH* b);
+
+// the fingerprint of a -output=bin record, see above
+extern void batch_fingerprint(unsigned char fp[BIN_FP_SIZE], unsigned long long key,
+    size_t length, const unsigned char tag[BIN_TAG_SIZE]);
+
+// maps the -output=bin file 'path' and indexes its records.
+// returns -1 if it can't be mapped or is not such a file.
+extern int since_open(struct SINCE* s, const char* path);
+
+// returns the password of the record with fingerprint 'fp', 0 if
+// there is none
+extern const unsigned char* since_find(const struct SINCE* s, const unsigned char* fp);
+extern void since_close(struct SINCE* s);
+
+// maps and locks (if 'lock') an empty set for 'entries' unique
+// (master, lengths, domain) records. returns -1 on errors.
+extern int dedup_open(struct DEDUP* d, unsigned long entries, int lock);
+
+// the entry of (tenant, lengths, domain). if there is none a new one
+// is added, *fresh is set then. returns 0 if there is none and the
+// set is full.
+extern struct DEDUP_ENTRY* dedup_get(struct DEDUP* d, unsigned long tenant,
+    unsigned int lengths, const unsigned char* domain, size_t len, int* fresh);
+extern void dedup_close(struct DEDUP* d);
+
+// the bytes of output record 'r' produces
+extern size_t batch_out_size(struct BATCH* b, struct BATCH_REC* r);
+
+#endif
@@ -0,0 +1,66 @@
+#!/bin/sh
+#
+# bench-startup.sh [csgp] - exec-to-exit cost of one single-shot run
+#
+# runs 'echo $MASTER | csgp -domain=example.com' RUNS times and prints
+# the wall-clock time per run (minus the time of the same loop running
+# /bin/true, so what is left is csgp) and the number of syscalls of
+# one run (needs strace). exits 1 if one of them is above
+#
+#   STARTUP_MAX_US          microseconds per run
+#   STARTUP_MAX_SYSCALLS    syscalls per run, execve() included
+#
+# both unset: no check. see 'make bench-startup-diet' for the limits
+# of the static dietlibc build.
+
+CSGP=${1:-./csgp}
+RUNS=${RUNS:-200}
+
+# a master of a realistic length: the single-shot run reads it with
+# one read(), whatever its length
+MASTER=correct-horse-battery
+
+now() {
+    date +%s%N
+}
+
+loop() {
+    i=0
+    while [ $i -lt $RUNS ]; do
+        echo $MASTER | "$@" > /dev/null
+        i=$((i + 1))
+    done
+}
+
+if [ "$(echo $MASTER | $CSGP -domain=example.com)" != "yecwKK8puN" ]; then
+    echo "error: $CSGP does not derive the right password" >&2
+    exit 1
+fi
+
+t0=$(now); loop /bin/true; t1=$(now)
+loop $CSGP -domain=example.com; t2=$(now)
+us=$(( ((t2 - t1) - (t1 - t0)) / RUNS / 1000 ))
+[ $us -lt 0 ] && us=0
+echo "time     $us us/run ($RUNS runs)"
+
+rc=0
+if [ -n "$STARTUP_MAX_US" ] && [ $us -gt "$STARTUP_MAX_US" ]; then
+    echo "error: above $STARTUP_MAX_US us" >&2
+    rc=1
+fi
+
+if command -v strace > /dev/null 2>&1; then
+    trace=$(mktemp)
+    echo $MASTER | strace -o "$trace" $CSGP -domain=example.com > /dev/null
+    calls=$(grep -cv '^+++\|^---' "$trace")
+    rm -f "$trace"
+    echo "syscalls $calls"
+    if [ -n "$STARTUP_MAX_SYSCALLS" ] && [ $calls -gt "$STARTUP_MAX_SYSCALLS" ]; then
+        echo "error: above $STARTUP_MAX_SYSCALLS syscalls" >&2
+        rc=1
+    fi
+else
+    echo "syscalls - (no strace)"
+fi
+
+exit $rc
@@ -0,0 +1,151 @@
+/*------------------------------------------------------------------*\
+
+       file: checkpoint.c
+      about: -checkpoint: the state of a long batch run on disk
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+   batch_write() saves a checkpoint after a chunk when the interval
+   is over: the output is flushed and fsynced first, then the
+   checkpoint is written to 'path'.tmp, fsynced and renamed to 'path'.
+   a crash leaves either the old or the new checkpoint, and the output
+   is at least as long as the checkpoint says. the bytes behind that
+   are cut by -resume and derived again.
+
+   the format is in batch.h. the numbers are written as u64, an
+   'unsigned long' is not always large enough for the offsets.
+
+\*------------------------------------------------------------------*/
+
+#include "batch.h"
+#include "platform.h"
+
+#include "djb/byte.h"
+#include "djb/str.h"
+
+enum {
+    CKPT_NUMBERS = 8,
+    CKPT_SIZE    = 256,
+    CKPT_PATH    = 1024,
+};
+
+static const char CKPT_MAGIC[] = "csgp-checkpoint 1";
+
+static size_t fmt_u64(char* s, unsigned long long v) {
+
+    char tmp[20];
+    size_t n = 0, i;
+
+    do {
+        tmp[n++] = (char)('0' + (v % 10));
+        v /= 10;
+    } while (v > 0);
+    for (i = 0; i < n; i++) {
+        s[i] = tmp[n - 1 - i];
+    }
+    return n;
+}
+
+static size_t scan_u64(const char* s, unsigned long long* v) {
+
+    size_t i;
+
+    for (*v = 0, i = 0; s[i] >= '0' && s[i] <= '9' && i < 20; i++) {
+        *v = (*v * 10) + (unsigned long long)(s[i] - '0');
+    }
+    return i;
+}
+
+static void ckpt_numbers(unsigned long long* v, const struct CHECKPOINT* ck) {
+    v[0] = ck->in_off;
+    v[1] = ck->out_len;
+    v[2] = ck->line;
+    v[3] = ck->tenants;
+    v[4] = ck->next_master;
+    v[5] = ck->records;
+    v[6] = ck->mismatches;
+    v[7] = ck->options;
+}
+
+/*------------------------------------------------------------------*\
+\*------------------------------------------------------------------*/
+
+int checkpoint_load(struct CHECKPOINT* ck, const char* path) {
+
+    char buf[CKPT_SIZE];
+    unsigned long long v[CKPT_NUMBERS];
+    size_t i, k, m = sizeof(CKPT_MAGIC) - 1;
+    int fd, n;
+
+    fd = posix_open(path);
+    if (fd == -1) {
+        return -1;
+    }
+    n = posix_read(fd, buf, sizeof(buf) - 1);
+    posix_close(fd);
+    if (n <= (int)m || byte_diff(buf, m, CKPT_MAGIC) != 0) {
+        return -1;
+    }
+    buf[n] = 0;
+
+    for (i = m, k = 0; k < CKPT_NUMBERS; k++) {
+        if (buf[i] != ' ') {
+            return -1;
+        }
+        n = (int)scan_u64(buf + i + 1, &v[k]);
+        if (n == 0) {
+            return -1;
+        }
+        i += 1 + n;
+    }
+    if (buf[i] != '\n') {
+        return -1;
+    }
+
+    ck->in_off = v[0];
+    ck->out_len = v[1];
+    ck->line = v[2];
+    ck->tenants = v[3];
+    ck->next_master = v[4];
+    ck->records = v[5];
+    ck->mismatches = v[6];
+    ck->options = v[7];
+    return 0;
+}
+
+int checkpoint_save(const struct CHECKPOINT* ck, const char* path) {
+
+    char buf[CKPT_SIZE];
+    char tmp[CKPT_PATH];
+    unsigned long long v[CKPT_NUMBERS];
+    size_t n, k, l = str_len(path);
+    int fd, rc = 0;
+
+    if (l + 5 > sizeof(tmp)) {
+        return -1;
+    }
+    byte_copy(tmp, l, path);
+    byte_copy(tmp + l, 5, ".tmp");
+
+    ckpt_numbers(v, ck);
+    n = sizeof(CKPT_MAGIC) - 1;
+    byte_copy(buf, n, CKPT_MAGIC);
+    for (k = 0; k < CKPT_NUMBERS; k++) {
+        buf[n++] = ' ';
+        n += fmt_u64(buf + n, v[k]);
+    }
+    buf[n++] = '\n';
+
+    fd = posix_create(tmp);
+    if (fd == -1) {
+        return -1;
+    }
+    if (posix_write(fd, buf, n) != (int)n || posix_fsync(fd) != 0) {
+        rc = -1;
+    }
+    posix_close(fd);
+    if (rc == 0 && posix_rename(tmp, path) != 0) {
+        rc = -1;
+    }
+    return rc;
+}
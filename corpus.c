@@ -0,0 +1,392 @@
+/*------------------------------------------------------------------*\
+
+       file: corpus.c
+      about: csgp-corpus writes synthetic -batch inputs for benchmarks
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+   the same -seed gives the same corpus, on every platform: the
+   generator is splitmix64, all the distributions are integer tables.
+
+   the shapes follow what public domain lists look like:
+
+   - tld: about half are .com, then a long tail of gTLDs, ccTLDs
+     and second level ccTLDs (co.uk, com.br, ...)
+   - the registered label is 8-10 characters most of the time, with
+     a tail up to the 63 characters dns allows
+   - 45% have no subdomain, 42% one (mostly 'www', 'mail', ...),
+     the rest two or more
+
+   the length of 'master:domain' decides if the first round of
+   supergenpass() needs one md5 block or two (> 55 bytes), the tail
+   of the label lengths and the deeper subdomains produce both.
+
+   -dups=pct repeats earlier lines, -urls=pct wraps the domain into
+   an url (scheme, user, port, path, query), -malformed=pct writes
+   broken ones (single slash, empty labels, trailing dot, overlong
+   labels, ...) which csgp accepts but (with -normalize) reduces to
+   odd hosts.
+
+\*------------------------------------------------------------------*/
+
+#include <stddef.h>
+#include "platform.h"
+
+#include "djb/byte.h"
+#include "djb/fmt.h"
+#include "djb/scan.h"
+#include "djb/str.h"
+
+const char USAGE[] = "csgp-corpus [-n=1000] [-seed=1] [-dups=0] [-urls=0] [-malformed=0]\n"
+                     "            [-tenants=0] [-lengths=0]\n"
+                     "\n"
+                     "  -dups, -urls, -malformed, -lengths: percent of the lines\n"
+                     "  -tenants=k: k master records, evenly spread";
+
+enum {
+    LINE_SIZE   = 512,
+    DUPS        = 1024,  // the last lines, for -dups
+    OUT_SIZE    = 65536,
+};
+
+struct WEIGHTED {
+    const char*     s;
+    unsigned int    w;
+};
+
+// per mille, roughly the shares of registered domains
+static const struct WEIGHTED TLDS[] = {
+    { "com", 470 }, { "net", 40 }, { "org", 45 }, { "de", 40 },
+    { "cn", 20 }, { "co.uk", 30 }, { "ru", 25 }, { "nl", 15 },
+    { "com.br", 15 }, { "com.au", 12 }, { "fr", 15 }, { "it", 12 },
+    { "eu", 10 }, { "pl", 10 }, { "co.jp", 8 }, { "in", 10 },
+    { "io", 12 }, { "info", 12 }, { "xyz", 15 }, { "ca", 10 },
+    { "es", 8 }, { "ch", 8 }, { "se", 6 }, { "us", 6 },
+    { "app", 6 }, { "dev", 5 }, { "be", 6 }, { "at", 6 },
+    { "online", 8 }, { "co", 8 }, { "me", 6 }, { "tv", 4 },
+    { "cz", 5 }, { "dk", 5 }, { "no", 4 }, { "fi", 3 },
+    { "gov", 2 }, { "edu", 5 }, { "ac.uk", 2 }, { "com.cn", 4 },
+    { "kr", 4 }, { "mx", 4 }, { "ir", 4 }, { "tk", 3 },
+    { "shop", 4 }, { "site", 5 }, { "store", 3 }, { "cloud", 2 },
+};
+
+static const struct WEIGHTED SUBS[] = {
+    { "www", 600 }, { "mail", 60 }, { "m", 40 }, { "api", 40 },
+    { "app", 30 }, { "blog", 30 }, { "shop", 20 }, { "login", 20 },
+    { "dev", 15 }, { "static", 15 }, { "cdn", 20 }, { "docs", 15 },
+    { "admin", 10 }, { "portal", 10 }, { "secure", 10 }, { "accounts", 10 },
+    { "my", 15 }, { "support", 15 }, { "en", 10 }, { "de", 5 },
+    { 0, 90 }, // a random label
+};
+
+// the length of the registered label, from 2 characters on
+static const unsigned int LABEL_LEN[] = {
+    5, 20, 40, 60, 85, 100, 110, 105, 95, 85, 70, 58, 45, 35, 27, 20, 15, 11, 9,
+};
+
+// 0 .. 4 subdomains
+static const unsigned int DEPTH[] = { 450, 420, 100, 25, 5 };
+
+struct OPTS {
+    unsigned long   n;
+    unsigned long   seed;
+    unsigned long   dups;
+    unsigned long   urls;
+    unsigned long   malformed;
+    unsigned long   tenants;
+    unsigned long   lengths;
+};
+
+struct CORPUS {
+    unsigned long long  state;
+    unsigned char       dup[DUPS][LINE_SIZE];
+    size_t              dup_len[DUPS];
+    unsigned long       dup_n;
+    size_t              out_len;
+    unsigned char       out[OUT_SIZE];
+};
+
+int get_opts(int argc, char* argv[], struct OPTS* opts);
+
+/*------------------------------------------------------------------*\
+\*------------------------------------------------------------------*/
+
+static unsigned long long splitmix64(unsigned long long* s) {
+
+    unsigned long long z = (*s += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static unsigned long rnd(struct CORPUS* c, unsigned long n) {
+    return (unsigned long)(splitmix64(&c->state) % n);
+}
+
+static int chance(struct CORPUS* c, unsigned long pct) {
+    return rnd(c, 100) < pct;
+}
+
+static size_t pick(struct CORPUS* c, const unsigned int* w, size_t n) {
+
+    unsigned long sum = 0, r;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        sum += w[i];
+    }
+    r = rnd(c, sum);
+    for (i = 0; i + 1 < n && r >= w[i]; i++) {
+        r -= w[i];
+    }
+    return i;
+}
+
+static const char* pick_str(struct CORPUS* c, const struct WEIGHTED* t, size_t n) {
+
+    unsigned int w[64];
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        w[i] = t[i].w;
+    }
+    return t[pick(c, w, n)].s;
+}
+
+static void put(struct CORPUS* c, const void* p, size_t n) {
+    if (c->out_len + n > sizeof(c->out)) {
+        posix_write(1, c->out, c->out_len);
+        c->out_len = 0;
+    }
+    byte_copy(c->out + c->out_len, n, p);
+    c->out_len += n;
+}
+
+static size_t add(unsigned char* line, size_t n, const char* s) {
+    size_t l = str_len(s);
+    if (n + l < LINE_SIZE) {
+        byte_copy(line + n, l, s);
+        n += l;
+    }
+    return n;
+}
+
+// a dns label: letters, some digits and hyphens, never a hyphen
+// at the start or the end
+static size_t label(struct CORPUS* c, unsigned char* line, size_t n, size_t len) {
+
+    static const char letters[] = "abcdefghijklmnopqrstuvwxyz";
+    unsigned long r;
+    size_t i;
+
+    for (i = 0; i < len && n < LINE_SIZE; i++) {
+        r = rnd(c, 100);
+        if (i > 0 && i + 1 < len && r < 3 && line[n-1] != '-') {
+            line[n++] = '-';
+        } else if (i > 0 && r < 8) {
+            line[n++] = (unsigned char)('0' + rnd(c, 10));
+        } else {
+            line[n++] = letters[rnd(c, 26)];
+        }
+    }
+    return n;
+}
+
+static size_t label_len(struct CORPUS* c) {
+
+    unsigned long r = rnd(c, 1000);
+
+    if (r < 45) {
+        return 21 + rnd(c, 20);
+    } else if (r < 50) {
+        return 41 + rnd(c, 23);
+    }
+    return 2 + pick(c, LABEL_LEN, sizeof(LABEL_LEN) / sizeof(LABEL_LEN[0]));
+}
+
+static size_t domain(struct CORPUS* c, unsigned char* line, size_t n) {
+
+    size_t depth = pick(c, DEPTH, sizeof(DEPTH) / sizeof(DEPTH[0]));
+    const char* sub;
+
+    for (; depth > 0; depth--) {
+        sub = pick_str(c, SUBS, sizeof(SUBS) / sizeof(SUBS[0]));
+        if (sub) {
+            n = add(line, n, sub);
+        } else {
+            n = label(c, line, n, 2 + rnd(c, 11));
+        }
+        n = add(line, n, ".");
+    }
+    n = label(c, line, n, label_len(c));
+    n = add(line, n, ".");
+    return add(line, n, pick_str(c, TLDS, sizeof(TLDS) / sizeof(TLDS[0])));
+}
+
+static size_t url(struct CORPUS* c, unsigned char* line, size_t n) {
+
+    char num[FMT_ULONG];
+    unsigned long i;
+
+    n = add(line, n, chance(c, 80) ? "https://" : "http://");
+    if (chance(c, 5)) {
+        n = label(c, line, n, 3 + rnd(c, 6));
+        n = add(line, n, "@");
+    }
+    n = domain(c, line, n);
+    if (chance(c, 10)) {
+        num[fmt_ulong(num, 1024 + rnd(c, 64000))] = 0;
+        n = add(line, n, ":");
+        n = add(line, n, num);
+    }
+    for (i = rnd(c, 4); i > 0; i--) {
+        n = add(line, n, "/");
+        n = label(c, line, n, 1 + rnd(c, 12));
+    }
+    if (chance(c, 20)) {
+        n = add(line, n, "?q=");
+        n = label(c, line, n, 1 + rnd(c, 16));
+    }
+    if (chance(c, 5)) {
+        n = add(line, n, "#top");
+    }
+    return n;
+}
+
+static size_t malformed(struct CORPUS* c, unsigned char* line, size_t n) {
+
+    size_t i, start = n;
+
+    switch (rnd(c, 6)) {
+    case 0: // a missing slash
+        n = add(line, n, "http:/");
+        return domain(c, line, n);
+    case 1: // an empty label
+        n = domain(c, line, n);
+        n = add(line, n, "..");
+        return add(line, n, "com");
+    case 2: // a trailing dot
+        n = domain(c, line, n);
+        return add(line, n, ".");
+    case 3: // upper case
+        n = domain(c, line, n);
+        for (i = start; i < n; i++) {
+            if (line[i] >= 'a' && line[i] <= 'z' && chance(c, 50)) {
+                line[i] -= 'a' - 'A';
+            }
+        }
+        return n;
+    case 4: // a label longer than 63 characters
+        n = label(c, line, n, 64 + rnd(c, 40));
+        return add(line, n, ".com");
+    }
+    // a bracketed ipv6 host
+    return add(line, n, "https://[2001:db8::1]:8443/x");
+}
+
+static void corpus_line(struct CORPUS* c, struct OPTS* opts) {
+
+    static const char* lengths[] = { "8", "12", "16", "8,16", "8-12", "20" };
+    unsigned char line[LINE_SIZE];
+    size_t n = 0;
+
+    if (c->dup_n > 0 && chance(c, opts->dups)) {
+        unsigned long d = rnd(c, c->dup_n < DUPS ? c->dup_n : DUPS);
+        put(c, c->dup[d], c->dup_len[d]);
+        return;
+    }
+
+    if (chance(c, opts->malformed)) {
+        n = malformed(c, line, n);
+    } else if (chance(c, opts->urls)) {
+        n = url(c, line, n);
+    } else {
+        n = domain(c, line, n);
+    }
+    if (chance(c, opts->lengths)) {
+        n = add(line, n, " ");
+        n = add(line, n, lengths[rnd(c, sizeof(lengths) / sizeof(lengths[0]))]);
+    }
+    n = add(line, n, "\n");
+
+    byte_copy(c->dup[c->dup_n % DUPS], n, line);
+    c->dup_len[c->dup_n % DUPS] = n;
+    c->dup_n++;
+    put(c, line, n);
+}
+
+/*------------------------------------------------------------------*\
+\*------------------------------------------------------------------*/
+
+int main(int argc, char* argv[]) {
+
+    static struct CORPUS c;
+    struct OPTS opts;
+    char buf[FMT_ULONG + 4];
+    unsigned long i, every = 0, tenant = 0;
+
+    opts.n = 1000;
+    opts.seed = 1;
+    opts.dups = 0;
+    opts.urls = 0;
+    opts.malformed = 0;
+    opts.tenants = 0;
+    opts.lengths = 0;
+
+    get_opts(argc, argv, &opts);
+
+    c.state = opts.seed;
+    if (opts.tenants > 0) {
+        every = (opts.n + opts.tenants - 1) / opts.tenants;
+    }
+
+    for (i = 0; i < opts.n; i++) {
+        if (every > 0 && (i % every) == 0) {
+            buf[0] = '@';
+            buf[1] = 't';
+            put(&c, buf, 2 + fmt_ulong(buf + 2, tenant++));
+            put(&c, "\n", 1);
+        }
+        corpus_line(&c, &opts);
+    }
+    posix_write(1, c.out, c.out_len);
+
+    return 0;
+}
+
+int get_opts(int argc, char* argv[], struct OPTS* opts) {
+
+    static const struct {
+        const char*     name;
+        size_t          offset;
+        unsigned long   max;
+    } num[] = {
+        { "-n=",         offsetof(struct OPTS, n),         0 },
+        { "-seed=",      offsetof(struct OPTS, seed),      0 },
+        { "-dups=",      offsetof(struct OPTS, dups),      100 },
+        { "-urls=",      offsetof(struct OPTS, urls),      100 },
+        { "-malformed=", offsetof(struct OPTS, malformed), 100 },
+        { "-tenants=",   offsetof(struct OPTS, tenants),   0 },
+        { "-lengths=",   offsetof(struct OPTS, lengths),   100 },
+    };
+    unsigned long* v;
+    size_t j, l;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        for (j = 0; j < sizeof(num) / sizeof(num[0]); j++) {
+            l = str_len(num[j].name);
+            if (str_diffn(argv[i], num[j].name, l) == 0) {
+                break;
+            }
+        }
+        if (j == sizeof(num) / sizeof(num[0])) {
+            return osexit(str_diff(argv[i], "-h") == 0 ? 0 : 1, USAGE);
+        }
+        v = (unsigned long*)((char*)opts + num[j].offset);
+        if (scan_ulong(&argv[i][l], v) == 0 || (num[j].max > 0 && *v > num[j].max)) {
+            return osexit(1, USAGE);
+        }
+    }
+    return 0;
+}
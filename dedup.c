@@ -0,0 +1,174 @@
+/*------------------------------------------------------------------*\
+
+       file: dedup.c
+      about: derives every (master, lengths, domain) of a batch once
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+   inventories repeat the same domains over and over. with -dedup
+   batch_derive() looks up every record in a hash set before it
+   derives it: a record which was derived before gets a copy of the
+   passwords, a record which is derived in the same chunk gets a copy
+   after the chunk is done. the output is the same as without it.
+
+   all of it lives in one arena, mapped once and locked (if b->lock),
+   nothing is allocated later. when it is full, new records are
+   derived as usual but not added:
+
+     [ slots ][ entries ][ domains ][ passwords ]
+
+   a slot is the upper 32 bits of the hash of the entry and the index
+   of the entry + 1 (0 is empty), the probing touches only the slots
+   until the tag matches. the hash is keyed with a random seed of the
+   run, the input can not pick the collisions.
+
+\*------------------------------------------------------------------*/
+
+#include "batch.h"
+#include "platform.h"
+#include "le.h"
+
+#include "djb/byte.h"
+
+enum {
+    DEDUP_TEXT = 32, // bytes of domain per entry, on average
+    DEDUP_PW   = 16, // bytes of passwords per entry, on average
+};
+
+static unsigned long long mix(unsigned long long h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static unsigned long long dd_hash(unsigned long long seed, unsigned long tenant,
+    unsigned int lengths, const unsigned char* p, size_t n) {
+
+    unsigned long long h = seed ^ (n * 0x9e3779b97f4a7c15ULL);
+    size_t i;
+
+    h = mix(h ^ tenant) ^ lengths;
+    for (i = 0; i + 8 <= n; i += 8) {
+        h = mix(h ^ get_le(p + i, 8));
+    }
+    return mix(h ^ get_le(p + i, n - i));
+}
+
+static unsigned long long dd_seed(void) {
+
+    unsigned long long seed = 0;
+    int fd = posix_open("/dev/urandom");
+
+    if (fd != -1) {
+        if (posix_read(fd, &seed, sizeof(seed)) != sizeof(seed)) {
+            seed = 0;
+        }
+        posix_close(fd);
+    }
+    return seed ^ posix_now();
+}
+
+/*------------------------------------------------------------------*\
+\*------------------------------------------------------------------*/
+
+int dedup_open(struct DEDUP* d, unsigned long entries, int lock) {
+
+    size_t off;
+
+    byte_zero(d, sizeof(*d));
+
+    for (d->slots = 16; d->slots < entries * 2; d->slots *= 2)
+        ;
+    d->cap = entries;
+    d->text_cap = entries * DEDUP_TEXT;
+    d->pw_cap = entries * DEDUP_PW;
+    d->arena_len = (d->slots * 2 * sizeof(d->slot[0])) +
+        (d->cap * sizeof(d->entry[0])) + d->text_cap + d->pw_cap;
+
+    d->arena = (unsigned char*)map_shared(d->arena_len);
+    if (d->arena == 0) {
+        return -1;
+    }
+    if (lock && lock_memory(d->arena, d->arena_len) != 0) {
+        unmap_shared(d->arena, d->arena_len);
+        d->arena = 0;
+        return -1;
+    }
+    d->lock = lock;
+    byte_zero(d->arena, d->arena_len);
+
+    off = 0;
+    d->slot = (unsigned int*)(d->arena + off);
+    off += d->slots * 2 * sizeof(d->slot[0]);
+    d->entry = (struct DEDUP_ENTRY*)(d->arena + off);
+    off += d->cap * sizeof(d->entry[0]);
+    d->text = d->arena + off;
+    off += d->text_cap;
+    d->pw = d->arena + off;
+
+    d->seed = dd_seed();
+    return 0;
+}
+
+struct DEDUP_ENTRY* dedup_get(struct DEDUP* d, unsigned long tenant,
+    unsigned int lengths, const unsigned char* domain, size_t len, int* fresh) {
+
+    unsigned long long h = dd_hash(d->seed, tenant, lengths, domain, len);
+    unsigned int tag = (unsigned int)(h >> 32);
+    unsigned int* s;
+    struct DEDUP_ENTRY* e;
+    size_t i, pw_len;
+
+    *fresh = 0;
+    for (i = (size_t)h & (d->slots - 1);; i = (i + 1) & (d->slots - 1)) {
+        s = d->slot + (i * 2);
+        if (s[1] == 0) {
+            break;
+        }
+        if (s[0] != tag) {
+            continue;
+        }
+        e = &d->entry[s[1] - 1];
+        if (e->tenant == tenant && e->lengths == lengths && e->dom_len == len &&
+            byte_equal(d->text + e->text_off, len, domain)) {
+            return e;
+        }
+    }
+
+    pw_len = sgp_lengths_size(lengths);
+    if (d->n == d->cap || d->text_len + len > d->text_cap || d->pw_len + pw_len > d->pw_cap) {
+        return 0;
+    }
+
+    e = &d->entry[d->n];
+    e->tenant = tenant;
+    e->lengths = lengths;
+    e->dom_len = (unsigned int)len;
+    e->text_off = (unsigned int)d->text_len;
+    e->pw_off = (unsigned int)d->pw_len;
+    e->ready = 0;
+    byte_copy(d->text + d->text_len, len, domain);
+    d->text_len += len;
+    d->pw_len += pw_len;
+
+    d->n++;
+    s[0] = tag;
+    s[1] = (unsigned int)d->n;
+    *fresh = 1;
+    return e;
+}
+
+void dedup_close(struct DEDUP* d) {
+
+    if (d->arena) {
+        byte_zero(d->arena, d->arena_len);
+        if (d->lock) {
+            unlock_memory(d->arena, d->arena_len);
+        }
+        unmap_shared(d->arena, d->arena_len);
+    }
+    byte_zero(d, sizeof(*d));
+}
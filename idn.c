@@ -0,0 +1,332 @@
+/*------------------------------------------------------------------*\
+
+       file: idn.c
+      about: -normalize: one spelling for every domain
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+   the domain goes as it is into the hash chain: "Bücher.example."
+   and "xn--bcher-kva.example" give different passwords although
+   they name the same host, and the browser (and thus supergenpass
+   itself) always sees the second one. -normalize brings both to
+   that form:
+
+     - case folding: ascii, latin-1, latin extended-a, greek and
+       cyrillic (the simple one-to-one foldings, no tables)
+     - the ideographic and fullwidth dots separate labels as well
+     - labels with non-ascii characters become 'xn--' punycode
+       (rfc 3492)
+     - no trailing dot
+
+   an url is reduced to its host first (see idn_host()).
+
+   it is not a full idna2008 mapping (no nfc, no bidi rules), but it
+   is what real inventories contain.
+
+   nearly every domain is lowercase ascii already. idn_plain() checks
+   8 bytes at once for that (no byte >= 0x80, none in 'A'..'Z') and
+   the caller skips idn_normalize() then.
+
+\*------------------------------------------------------------------*/
+
+#include "idn.h"
+#include "le.h"
+
+enum {
+    MAX_LABEL = 255, // code points of one label
+
+    // rfc 3492, 5.
+    PC_BASE  = 36,
+    PC_TMIN  = 1,
+    PC_TMAX  = 26,
+    PC_SKEW  = 38,
+    PC_DAMP  = 700,
+    PC_BIAS  = 72,
+    PC_N     = 128,
+};
+
+#define ONES  0x0101010101010101ULL
+#define HIGHS 0x8080808080808080ULL
+
+int idn_plain(const unsigned char* p, size_t n) {
+
+    unsigned long long w, ge_a, ge_z;
+    size_t i, k;
+
+    if (n > 0 && p[n-1] == '.') {
+        return 0;
+    }
+    for (i = 0; i < n; i += 8) {
+        k = (n - i < 8) ? n - i : 8;
+        w = get_le(p + i, k);
+        if (w & HIGHS) {
+            return 0;
+        }
+        // all bytes < 0x80: no carry crosses a byte
+        ge_a = w + (0x80 - 'A') * ONES;       // byte >= 'A'
+        ge_z = w + (0x80 - 'Z' - 1) * ONES;   // byte >  'Z'
+        if (ge_a & ~ge_z & HIGHS) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*------------------------------------------------------------------*\
+\*------------------------------------------------------------------*/
+
+// reduces an url to its host:
+//
+//   https://user@www.example.com:8080/path?q#f -> www.example.com
+//
+// a plain domain stays as it is.
+void idn_host(const unsigned char* text, size_t* off, size_t* len) {
+
+    const unsigned char* p = text + *off;
+    size_t n = *len;
+    size_t i, start = 0;
+
+    for (i = 0; i + 2 < n; i++) {
+        if (p[i] == ':' && p[i+1] == '/' && p[i+2] == '/') {
+            start = i + 3;
+            break;
+        }
+        if (p[i] == '/' || p[i] == '.') {
+            break;
+        }
+    }
+    for (i = start; i < n; i++) {
+        if (p[i] == '/' || p[i] == '?' || p[i] == '#') {
+            break;
+        }
+    }
+    n = i;
+    for (i = start; i < n; i++) {
+        if (p[i] == '@') {
+            start = i + 1;
+        }
+    }
+    if (start < n && p[start] == '[') { // [::1]:8080
+        for (i = start; i < n && p[i] != ']'; i++)
+            ;
+        n = (i < n) ? i + 1 : n;
+    } else {
+        for (i = start; i < n && p[i] != ':'; i++)
+            ;
+        n = i;
+    }
+
+    *off += start;
+    *len = n - start;
+}
+
+// one code point from p[*i], -1 if it is not utf-8
+static long utf8_next(const unsigned char* p, size_t n, size_t* i) {
+
+    unsigned long c = p[*i];
+    size_t len, k;
+
+    if (c < 0x80) {
+        (*i)++;
+        return (long)c;
+    } else if (c >= 0xc2 && c < 0xe0) {
+        len = 2;
+        c &= 0x1f;
+    } else if (c >= 0xe0 && c < 0xf0) {
+        len = 3;
+        c &= 0x0f;
+    } else if (c >= 0xf0 && c < 0xf5) {
+        len = 4;
+        c &= 0x07;
+    } else {
+        return -1;
+    }
+    if (*i + len > n) {
+        return -1;
+    }
+    for (k = 1; k < len; k++) {
+        if ((p[*i + k] & 0xc0) != 0x80) {
+            return -1;
+        }
+        c = (c << 6) | (p[*i + k] & 0x3f);
+    }
+    if ((len == 3 && c < 0x800) || (len == 4 && (c < 0x10000 || c > 0x10ffff)) ||
+        (c >= 0xd800 && c <= 0xdfff)) {
+        return -1; // overlong, out of range, surrogate
+    }
+    *i += len;
+    return (long)c;
+}
+
+static unsigned long fold(unsigned long c) {
+
+    if (c >= 'A' && c <= 'Z') {
+        return c + 32;
+    }
+    if (c < 0xc0) {
+        return c;
+    }
+    if (c <= 0xde && c != 0xd7) {                   // latin-1
+        return c + 32;
+    }
+    if (c >= 0x100 && c <= 0x17f) {                 // latin extended-a
+        if (c == 0x130) {
+            return 'i';
+        }
+        if (c == 0x178) {
+            return 0xff;
+        }
+        if ((c < 0x138 || (c >= 0x14a && c < 0x178)) && (c & 1) == 0) {
+            return c + 1;
+        }
+        if (((c > 0x138 && c < 0x149) || (c > 0x178 && c < 0x17f)) && (c & 1) == 1) {
+            return c + 1;
+        }
+        return c;
+    }
+    if (c >= 0x391 && c <= 0x3a9 && c != 0x3a2) {   // greek
+        return c + 32;
+    }
+    if (c >= 0x400 && c <= 0x40f) {                 // cyrillic
+        return c + 80;
+    }
+    if (c >= 0x410 && c <= 0x42f) {
+        return c + 32;
+    }
+    return c;
+}
+
+static int is_dot(unsigned long c) {
+    return c == '.' || c == 0x3002 || c == 0xff0e || c == 0xff61;
+}
+
+static char pc_digit(unsigned long d) {
+    return (char)(d < 26 ? 'a' + d : '0' + (d - 26));
+}
+
+static unsigned long pc_adapt(unsigned long delta, unsigned long points, int first) {
+
+    unsigned long k = 0;
+
+    delta = first ? delta / PC_DAMP : delta / 2;
+    delta += delta / points;
+    while (delta > ((PC_BASE - PC_TMIN) * PC_TMAX) / 2) {
+        delta /= PC_BASE - PC_TMIN;
+        k += PC_BASE;
+    }
+    return k + (((PC_BASE - PC_TMIN + 1) * delta) / (delta + PC_SKEW));
+}
+
+// the label 'cp' (m code points) to out[*o], as it is if it is
+// all ascii, punycode otherwise. 0 if there is no room.
+static int put_label(unsigned char* out, size_t max, size_t* o,
+    const unsigned long* cp, size_t m) {
+
+    unsigned long n = PC_N, delta = 0, bias = PC_BIAS, mn, q, t, k;
+    size_t i, b = 0, h;
+
+    for (i = 0; i < m; i++) {
+        b += (cp[i] < 0x80);
+    }
+    if (b == m) {
+        if (*o + m > max) {
+            return 0;
+        }
+        for (i = 0; i < m; i++) {
+            out[(*o)++] = (unsigned char)cp[i];
+        }
+        return 1;
+    }
+
+    if (*o + 4 + b + (b > 0) > max) {
+        return 0;
+    }
+    out[(*o)++] = 'x'; out[(*o)++] = 'n'; out[(*o)++] = '-'; out[(*o)++] = '-';
+    for (i = 0; i < m; i++) {
+        if (cp[i] < 0x80) {
+            out[(*o)++] = (unsigned char)cp[i];
+        }
+    }
+    if (b > 0) {
+        out[(*o)++] = '-';
+    }
+
+    for (h = b; h < m; n++, delta++) {
+        for (mn = (unsigned long)-1, i = 0; i < m; i++) {
+            if (cp[i] >= n && cp[i] < mn) {
+                mn = cp[i];
+            }
+        }
+        delta += (mn - n) * (h + 1);
+        n = mn;
+        for (i = 0; i < m; i++) {
+            if (cp[i] < n) {
+                delta++;
+            }
+            if (cp[i] != n) {
+                continue;
+            }
+            for (q = delta, k = PC_BASE;; k += PC_BASE) {
+                t = (k <= bias) ? PC_TMIN : (k >= bias + PC_TMAX) ? PC_TMAX : k - bias;
+                if (q < t) {
+                    break;
+                }
+                if (*o >= max) {
+                    return 0;
+                }
+                out[(*o)++] = (unsigned char)pc_digit(t + ((q - t) % (PC_BASE - t)));
+                q = (q - t) / (PC_BASE - t);
+            }
+            if (*o >= max) {
+                return 0;
+            }
+            out[(*o)++] = (unsigned char)pc_digit(q);
+            bias = pc_adapt(delta, h + 1, h == b);
+            delta = 0;
+            h++;
+        }
+    }
+    return 1;
+}
+
+size_t idn_normalize(unsigned char* out, size_t max, const unsigned char* in, size_t n) {
+
+    unsigned long cp[MAX_LABEL];
+    size_t i = 0, o = 0, m = 0;
+    long c = 0;
+    int end;
+
+    for (;;) {
+        end = (i == n);
+        if (!end) {
+            c = utf8_next(in, n, &i);
+            if (c < 0) {
+                return 0;
+            }
+            if (!is_dot((unsigned long)c)) {
+                if (m == MAX_LABEL) {
+                    return 0;
+                }
+                cp[m++] = fold((unsigned long)c);
+                continue;
+            }
+        }
+        if (!put_label(out, max, &o, cp, m)) {
+            return 0;
+        }
+        m = 0;
+        if (end) {
+            break;
+        }
+        if (o >= max) {
+            return 0;
+        }
+        out[o++] = '.';
+    }
+
+    // "example.com." ends with a '.' and an empty label
+    while (o > 0 && out[o-1] == '.') {
+        o--;
+    }
+    return o;
+}
@@ -0,0 +1,30 @@
+#ifndef _IDN_H_
+#define _IDN_H_
+
+/*------------------------------------------------------------------*\
+
+       file: idn.h
+      about: -normalize: one spelling for every domain
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+\*------------------------------------------------------------------*/
+
+#include <stddef.h>
+
+// moves text[*off, +*len) to the host if it is an url:
+// "https://user@www.example.com:8080/path?q#f" -> "www.example.com".
+// a plain domain stays as it is.
+extern void idn_host(const unsigned char* text, size_t* off, size_t* len);
+
+// 1 if 'p' is lowercase ascii without a trailing dot already, the
+// case of (almost) every domain. idn_normalize() would not change it.
+extern int idn_plain(const unsigned char* p, size_t n);
+
+// writes the ascii form of the domain 'in' (utf-8) to 'out': case
+// folded, every label with non-ascii characters as 'xn--' punycode,
+// without a trailing dot. returns its length, 0 if 'in' is not
+// utf-8 or the result is longer than 'max'.
+extern size_t idn_normalize(unsigned char* out, size_t max, const unsigned char* in, size_t n);
+
+#endif
@@ -0,0 +1,18 @@
+/*------------------------------------------------------------------*\
+
+       file: le.c
+      about: reads little-endian numbers from bytes
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+\*------------------------------------------------------------------*/
+
+#include "le.h"
+
+unsigned long long get_le(const unsigned char* p, size_t n) {
+    unsigned long long v = 0;
+    for (; n > 0; n--) {
+        v = (v << 8) | p[n-1];
+    }
+    return v;
+}
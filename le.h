@@ -0,0 +1,19 @@
+#ifndef _LE_H_
+#define _LE_H_
+
+/*------------------------------------------------------------------*\
+
+       file: le.h
+      about: reads little-endian numbers from bytes
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+\*------------------------------------------------------------------*/
+
+#include <stddef.h>
+
+// the first 'n' (at most 8) bytes of 'p' as a little-endian number,
+// whatever the byte order of the machine is
+extern unsigned long long get_le(const unsigned char* p, size_t n);
+
+#endif
@@ -8,121 +8,139 @@
      author: m. gumz <mg@2hoch5.com>
     license: see LICENSE.txt
 
-   SUPERGENPASS:
-
-     in_pw:domain
-      |
-      v
-     input -> md5Context.state     (16bytes)
-      ^            |
-      |            v
-      |       md5_final(raw, &ctx) (16bytes)
-      |            |
-      |            v
-      |       base64(out, raw)     (24bytes)
-      |            |
-      |            v
-      +------ is_valid()
-                   |
-                   v
-                  out
-   notes:
-
-   - the initial password is stored only once in the working
-     buffer. it get's overwritten in the first round already.
-   - for the whole process we allocate only 25 bytes: the amount
-     of ram needed to base64_encode(16 bytes) == 24 bytes PLUS
-     1 extra byte to detect, if the given master password is too
-     long (see read_pw()).
-   - the 16 bytes for the digest are stored inside the 24 byte buffer
-     (like this: [24......[16..............]] ). this works because
-     * the master-passwords ends directly as a md5-state in the first round
-     * the md5-state is copied over into the 16byte block
-     * the 16byte block gets base64-encoded. the b64-encoder chases the
-       currently processed byte from the 16byte block but never catches
-       up; except for the last round. in that round, any trace of the raw
-       md5-state got erased by the base64-version of it:
-
-           +--------+
-       [aaaa.......[111.........]]
-       [aaaabbbb...[111222......]]
-       [aaaabbbbccc[c11222333...]]
-
-     * the 24byte buffer is then transformed into a md5-state and
-       the whole process repeats.
-
-   - in addition we need one md5Context and bytes for the
-     domain which we get by argv[]
-   - all sensitive information gets overwritten as soon
-     as it is not needed anymore
+   see sgp.c for the algorithm and batch.h for the batch format.
 
 \*------------------------------------------------------------------*/
 
-#include "md5.h"
-#include "base64.h"
+#include "sgp.h"
+#include "batch.h"
+#include "measure.h"
+#include "idn.h"
 #include "platform.h"
 
 #include "djb/str.h"
 #include "djb/scan.h"
 #include "djb/byte.h"
+#include "djb/fmt.h"
 
 /*------------------------------------------------------------------*\
 \*------------------------------------------------------------------*/
 
-const char USAGE[]  = "csgp -domain=xyz [-length=10] [-nolock]";
-const char PROMPT[] = "password: ";
+const char USAGE[]  = "csgp -domain=xyz [-length=10[,16|-12]] [-nolock] [-keyring[=300]]\n"
+                      "     [-normalize] [-measure[=10000]]\n"
+                      "csgp -batch=file [-masterfd=0] [-length=10[,16|-12]] [-nolock]\n"
+                      "     [-pipeline] [-procs=n] [-stats] [-output=text|bin] [-flush=n]\n"
+                      "     [-since=old.bin] [-dedup[=32768]] [-normalize] [-verify]\n"
+                      "     [-coalesce[=500]] [-checkpoint=file [-checkpoint-every=60] [-resume]]\n"
+                      "     [-uring]\n"
+                      "csgp -forget\n"
+                      "csgp -md5sum=file [-stats]";
 
-// special base64-table to replace
-// '+' -> 9
-// '/' -> 8
-// '=' => A (the padding sign)
-const unsigned char B64_SGP_TABLE[BASE64_LUT_LEN] =
-    "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-    "abcdefghijklmnopqrstuvwxyz"
-    "012345678998A";
+// the description of the master in the session keyring
+const char KEYRING_NAME[] = "csgp:master";
 
 enum {
-    MIN_PW_LENGTH         = 4,
-    DEFAULT_PW_LENGTH     = 10,
-    MAX_ROUNDS            = 10,
-    B64_MD5_DIGEST_LENGTH = 24, // base_encded_len(MD5_DIGEST_LENGTH)
+    DEFAULT_KEYRING_TIMEOUT = 300, // seconds
+    DOMAIN_MAX              = 256, // longer ones are locked in argv
 };
 
-
-/*------------------------------------------------------------------*\
-\*------------------------------------------------------------------*/
-
-struct SGP;
-int supergenpass(struct SGP*);
-int read_pw(int fd, unsigned char* pw, size_t max_len);
-int get_opts(int argc, char* argv[], size_t* len, unsigned char** domain, int* lock);
-int is_valid(const unsigned char* pw, size_t len);
-
 /*------------------------------------------------------------------*\
 \*------------------------------------------------------------------*/
 
-struct SGP {
-    size_t          in_len;   // length of input password
-    size_t          out_len;  // length of generated password
-    unsigned char   pw[B64_MD5_DIGEST_LENGTH+1]; // see 'notes' above
-    md5Context      md5;
+struct OPTS {
+    unsigned int    lengths;    // see SGP_LENGTH()
     unsigned char*  domain;
-    size_t          domain_len;
+    int             lock;
+    char*           batch;      // file with the batch input, "-" is stdin
+    int             master_fd;  // the fd to read the master(s) from
+    unsigned int    keyring;    // timeout of the master in the keyring
+    int             forget;     // revoke the master from the keyring
+    int             pipeline;   // run the batch stages concurrently
+    unsigned long   procs;      // run the batch in n processes
+    int             stats;
+    int             output;     // OUTPUT_TEXT or OUTPUT_BIN
+    unsigned long   flush;      // flush the output every n records
+    char*           md5sum;     // print the md5 of this file
+    char*           since;      // reuse this -output=bin file
+    unsigned long   measure;    // time the stages of the chain n times
+    unsigned long   dedup;      // derive repeated records once
+    int             normalize;  // case folding, punycode (see idn.c)
+    int             verify;     // check the passwords in the batch input
+    unsigned long   coalesce;   // answer a stream in time, see batch.c
+    char*           checkpoint; // save the state of the batch run here
+    unsigned long   checkpoint_every; // seconds
+    int             resume;     // continue from the checkpoint
+    int             uring;      // batch i/o on io_uring, if there is one
+};
+
+// the secrets of a single -domain run, see main()
+struct SINGLE {
+    struct SGP      sgp;
+    unsigned char   domain[DOMAIN_MAX];
+    unsigned char   out[MAX_LENGTHS_SIZE]; // for more than one -length
+    unsigned char   line[MAX_LENGTHS_SIZE + B64_MD5_DIGEST_LENGTH]; // '\n' framed
 };
 
+int get_opts(int argc, char* argv[], struct OPTS* opts);
+int main_batch(struct OPTS* opts);
+int main_md5sum(struct OPTS* opts);
+
 /*------------------------------------------------------------------*\
 \*------------------------------------------------------------------*/
 
 int main(int argc, char* argv[]) {
 
-    struct SGP sgp;
+    struct SINGLE st;
+    struct OPTS opts;
     unsigned char* domain = 0;
-    int domain_len = 0;
+    size_t domain_len = 0;
     int lock = 1;
+    size_t l, off, n;
+    int multi, tty;
+
+    opts.lengths = SGP_LENGTH(DEFAULT_PW_LENGTH);
+    opts.domain = 0;
+    opts.lock = 1;
+    opts.batch = 0;
+    opts.master_fd = 0;
+    opts.keyring = 0;
+    opts.forget = 0;
+    opts.pipeline = 0;
+    opts.procs = 0;
+    opts.stats = 0;
+    opts.output = OUTPUT_TEXT;
+    opts.flush = 0;
+    opts.md5sum = 0;
+    opts.since = 0;
+    opts.measure = 0;
+    opts.dedup = 0;
+    opts.normalize = 0;
+    opts.verify = 0;
+    opts.coalesce = 0;
+    opts.checkpoint = 0;
+    opts.checkpoint_every = DEFAULT_CHECKPOINT_SECS;
+    opts.resume = 0;
+    opts.uring = 0;
+
+    get_opts(argc, argv, &opts);
+
+    if (opts.forget) {
+        if (keyring_forget(KEYRING_NAME) != 0) {
+            return osexit(6, "error: no master in the keyring");
+        }
+        return 0;
+    }
 
-    sgp.out_len = DEFAULT_PW_LENGTH;
+    if (opts.md5sum) {
+        return main_md5sum(&opts);
+    }
 
-    get_opts(argc, argv, &sgp.out_len, &domain, &lock);
+    if (opts.batch) {
+        return main_batch(&opts);
+    }
+
+    domain = opts.domain;
+    lock = opts.lock;
 
     if (!domain) {
         return osexit(1, "usage: csgp -domain=\"example.com\"");
@@ -130,194 +148,438 @@ int main(int argc, char* argv[]) {
 
     domain_len = str_len(domain);
 
+    // all of the state in one mlock(). a domain which does not fit
+    // stays in argv and is locked there.
     if (lock) {
-        if (lock_memory(domain, domain_len) != 0) {
+        if (lock_memory(&st, sizeof(st)) != 0) {
             return osexit(4, "error: can't lock memory");
         }
-        if (lock_memory(&sgp, sizeof(sgp)) != 0) {
+        if (domain_len > sizeof(st.domain) && lock_memory(domain, domain_len) != 0) {
             return osexit(4, "error: can't lock memory");
         }
     }
-
-    if ((sgp.out_len < MIN_PW_LENGTH) || (sgp.out_len > B64_MD5_DIGEST_LENGTH)) {
-        return osexit(1, "error: given -length must be >= 4 and <= 24");
+    if (opts.normalize) {
+        off = 0;
+        n = domain_len;
+        idn_host(domain, &off, &n);
+        if (idn_plain(domain + off, n) && n <= sizeof(st.domain)) {
+            byte_copy(st.domain, n, domain + off);
+            st.sgp.domain_len = n;
+        } else {
+            st.sgp.domain_len = idn_normalize(st.domain, sizeof(st.domain), domain + off, n);
+        }
+        if (st.sgp.domain_len == 0) {
+            return osexit(1, "error: -domain is empty, not utf-8 or too long");
+        }
+        byte_zero(domain, domain_len);
+        st.sgp.domain = st.domain;
+    } else if (domain_len <= sizeof(st.domain)) {
+        byte_copy(st.domain, domain_len, domain);
+        byte_zero(domain, domain_len);
+        st.sgp.domain = st.domain;
+        st.sgp.domain_len = domain_len;
+    } else {
+        st.sgp.domain = domain;
+        st.sgp.domain_len = domain_len;
     }
 
-    sgp.domain = domain;
-    sgp.domain_len = domain_len;
-
-    sgp.in_len = read_pw(0, sgp.pw, sizeof(sgp.pw));
+    st.sgp.out_len = 0;
+    for (l = MIN_PW_LENGTH; l <= B64_MD5_DIGEST_LENGTH; l++) {
+        if (opts.lengths == SGP_LENGTH(l)) {
+            st.sgp.out_len = l;
+        }
+    }
+    multi = (st.sgp.out_len == 0);
+
+    // before the master is read: the error path has only the domain
+    // to wipe
+    if (opts.measure && multi) {
+        byte_zero(domain, domain_len);
+        byte_zero(&st, sizeof(st));
+        if (lock) {
+            if (domain_len > sizeof(st.domain)) {
+                unlock_memory(domain, domain_len);
+            }
+            unlock_memory(&st, sizeof(st));
+        }
+        return osexit(1, "error: -measure takes only one -length");
+    }
 
-    supergenpass(&sgp);
+    // the keyring holds at most 24 bytes, the master is already
+    // checked by read_pw() when it was stored
+    st.sgp.in_len = 0;
+    if (opts.keyring) {
+        int k = keyring_load(KEYRING_NAME, st.sgp.pw, sizeof(st.sgp.pw) - 1);
+        if (k > 0) {
+            st.sgp.in_len = (size_t)k;
+        }
+    }
+    if (st.sgp.in_len == 0) {
+        st.sgp.in_len = read_pw(opts.master_fd, st.sgp.pw, sizeof(st.sgp.pw), 0);
+        if (opts.keyring) {
+            if (keyring_store(KEYRING_NAME, st.sgp.pw, st.sgp.in_len, opts.keyring) != 0) {
+                posix_write(2, "warning: can't store master in keyring\n", 39);
+            }
+        }
+    }
 
-    if (posix_isatty(1)) {
-        posix_write(1, "\n", 1);
-        posix_write(1, sgp.pw, sgp.out_len);
-        posix_write(1, "\n", 1);
+    // the whole output goes out with one write(): on a terminal
+    // framed by newlines, on a pipe without the trailing one
+    tty = 0;
+    n = 0;
+    if (opts.measure) {
+        measure_run(&st.sgp, opts.measure, lock);
     } else {
-        posix_write(1, sgp.pw, sgp.out_len);
+        tty = posix_isatty(1);
+        if (tty) {
+            st.line[n++] = '\n';
+        }
+        if (!multi) {
+            supergenpass(&st.sgp);
+            byte_copy(st.line + n, st.sgp.out_len, st.sgp.pw);
+            n += st.sgp.out_len;
+        } else {
+            // one password per line, shortest first
+            supergenpass_lengths(&st.sgp, opts.lengths, st.out);
+            for (off = 0, l = MIN_PW_LENGTH; l <= B64_MD5_DIGEST_LENGTH; l++) {
+                if (opts.lengths & SGP_LENGTH(l)) {
+                    if (off > 0) {
+                        st.line[n++] = '\n';
+                    }
+                    byte_copy(st.line + n, l, st.out + off);
+                    n += l;
+                    off += l;
+                }
+            }
+        }
+        if (tty) {
+            st.line[n++] = '\n';
+        }
+        posix_write(1, st.line, n);
     }
-    posix_fsync(1);
 
     byte_zero(domain, domain_len);
-    byte_zero(&sgp, sizeof(sgp));
+    byte_zero(&st, sizeof(st));
 
     if (lock) {
-        unlock_memory(&sgp, sizeof(sgp));
-        unlock_memory(domain, domain_len);
+        if (domain_len > sizeof(st.domain)) {
+            unlock_memory(domain, domain_len);
+        }
+        unlock_memory(&st, sizeof(st));
     }
 
     return 0;
 }
 
+int main_batch(struct OPTS* opts) {
+
+    struct BATCH b;
+    struct SINCE since;
+    struct DEDUP dedup;
+    struct CHECKPOINT ck;
+    unsigned long mismatches;
+    const unsigned char* mem = 0;
+    size_t mem_len = 0;
+    int fd = 0;
+
+    if (opts->since) {
+        if (opts->output != OUTPUT_BIN) {
+            return osexit(1, "error: -since needs -output=bin");
+        }
+        if (since_open(&since, opts->since) != 0) {
+            return osexit(1, "error: -since is not a -output=bin file");
+        }
+    }
+
+    if (opts->verify && (opts->output == OUTPUT_BIN || opts->since || opts->procs > 1)) {
+        return osexit(1, "error: -verify writes text, without -since and -procs");
+    }
+
+    if (opts->resume && !opts->checkpoint) {
+        return osexit(1, "error: -resume needs -checkpoint");
+    }
+    if (opts->checkpoint && (opts->procs > 1 || str_diff(opts->batch, "-") == 0)) {
+        return osexit(1, "error: -checkpoint needs a -batch file, without -procs");
+    }
+    if (opts->resume && checkpoint_load(&ck, opts->checkpoint) != 0) {
+        return osexit(1, "error: can't read the -checkpoint file");
+    }
+
+    if (str_diff(opts->batch, "-") == 0) {
+        if (opts->master_fd == 0) {
+            return osexit(1, "error: -batch=- needs -masterfd");
+        }
+        if (opts->procs > 1) {
+            return osexit(1, "error: -procs needs a -batch file");
+        }
+    } else if (opts->procs > 1) {
+        // the workers share the mapping, see procs.c
+        mem = map_file(opts->batch, &mem_len);
+        if (mem == 0) {
+            return osexit(1, "error: can't map -batch file");
+        }
+    } else {
+        fd = posix_open(opts->batch);
+        if (fd == -1) {
+            return osexit(1, "error: can't open -batch file");
+        }
+    }
+
+    if (opts->lock) {
+        if (lock_memory(&b, sizeof(b)) != 0) {
+            return osexit(4, "error: can't lock memory");
+        }
+    }
+
+    // with -procs every worker maps its own set, see procs.c
+    byte_zero(&dedup, sizeof(dedup));
+    dedup.cap = opts->dedup;
+    if (opts->dedup && opts->procs <= 1) {
+        if (dedup_open(&dedup, opts->dedup, opts->lock) != 0) {
+            return osexit(4, "error: can't map memory for -dedup");
+        }
+    }
 
-int supergenpass(struct SGP* sgp) {
+    batch_init(&b, fd, 1, opts->master_fd, opts->lengths);
+    b.lock = opts->lock;
+    b.pipeline = opts->pipeline;
+    b.procs = (int)opts->procs;
+    b.in.mem = (unsigned char*)mem;
+    b.in.mem_len = mem_len;
+    b.stats = opts->stats;
+    b.output = opts->output;
+    b.flush_every = opts->flush;
+    b.since = opts->since ? &since : 0;
+    b.dedup = opts->dedup ? &dedup : 0;
+    b.normalize = opts->normalize;
+    b.verify = opts->verify;
+    b.coalesce = opts->coalesce;
+    b.uring = opts->uring;
+    b.checkpoint = opts->checkpoint;
+    b.checkpoint_ns = (unsigned long long)opts->checkpoint_every * 1000000000ULL;
+    if (opts->resume) {
+        batch_resume(&b, &ck);
+    }
+    batch_run(&b);
+    mismatches = b.mismatches;
 
-    md5Context* ctx = &(sgp->md5);
-    unsigned char* pw = &(sgp->pw[0]);
-    unsigned char* raw = &(sgp->pw[B64_MD5_DIGEST_LENGTH-MD5_DIGEST_LENGTH]);
-    int round;
-    md5_init(ctx);
+    byte_zero(&b, sizeof(b));
 
-    // the initial round
-    md5_update(ctx, pw, sgp->in_len);
-    md5_update(ctx, (unsigned char*)":", 1);
-    md5_update(ctx, sgp->domain, sgp->domain_len);
-    md5_final(raw, ctx);
-    base64_encode(pw, raw, MD5_DIGEST_LENGTH, B64_SGP_TABLE);
+    if (opts->lock) {
+        unlock_memory(&b, sizeof(b));
+    }
+    if (fd != 0) {
+        posix_close(fd);
+    }
+    if (mem) {
+        unmap_file(mem, mem_len);
+    }
+    if (opts->since) {
+        since_close(&since);
+    }
+    dedup_close(&dedup);
 
-    // the other MAX_ROUNDS - 1
-    for (round = 1; round < MAX_ROUNDS; round++) {
-        md5_init(ctx);
-        md5_update(ctx, pw, B64_MD5_DIGEST_LENGTH);
-        md5_final(raw, ctx);
-        base64_encode(pw, raw, MD5_DIGEST_LENGTH, B64_SGP_TABLE);
+    if (mismatches > 0) {
+        return 7;
     }
+    return 0;
+}
+
+// prints the md5 of a file like md5sum(1) does. the file is mapped
+// and hashed straight from the mapping.
+int main_md5sum(struct OPTS* opts) {
+
+    const char hex[] = "0123456789abcdef";
+    unsigned char digest[MD5_DIGEST_LENGTH];
+    char out[MD5_DIGEST_STRING_LENGTH + 1];
+    md5Context ctx;
+    const unsigned char* p;
+    size_t n = 0;
+    unsigned long long t;
+    int i;
 
-    // continue until the pw is valid
-    for (; is_valid(pw, sgp->out_len) == 0; ) {
-        md5_init(ctx);
-        md5_update(ctx, pw, B64_MD5_DIGEST_LENGTH);
-        md5_final(raw, ctx);
-        base64_encode(pw, raw, MD5_DIGEST_LENGTH, B64_SGP_TABLE);
+    p = map_file(opts->md5sum, &n);
+    if (p == 0) {
+        return osexit(1, "error: can't map -md5sum file");
     }
 
-    // cleanup: md5_final() sets all elements of ctx to 0.
-    // the user is interested only in the first sgp->out_len bytes
-    // of sgp->pw anyway: 0 the rest.
-    byte_zero(pw + sgp->out_len, sizeof(sgp->pw) - sgp->out_len);
-    return 1;
+    t = posix_now();
+    md5_init(&ctx);
+    md5_update(&ctx, p, n);
+    md5_final(digest, &ctx);
+    t = posix_now() - t;
+    unmap_file(p, n);
+
+    for (i = 0; i < MD5_DIGEST_LENGTH; i++) {
+        out[i*2] = hex[digest[i] >> 4];
+        out[i*2+1] = hex[digest[i] & 0xf];
+    }
+    out[MD5_DIGEST_LENGTH*2] = ' ';
+    out[MD5_DIGEST_LENGTH*2+1] = ' ';
+    posix_write(1, out, MD5_DIGEST_LENGTH*2 + 2);
+    posix_write(1, opts->md5sum, str_len(opts->md5sum));
+    posix_write(1, "\n", 1);
+
+    if (opts->stats) {
+        char buf[FMT_ULONG + 8];
+        unsigned int l = fmt_ulong(buf, t > 0 ? (unsigned long)((n * 1000ULL) / t) : 0);
+        byte_copy(buf + l, 6, " MB/s\n");
+        posix_write(2, buf, l + 6);
+    }
+    return 0;
 }
 
 /*------------------------------------------------------------------*\
 \*------------------------------------------------------------------*/
 
-int get_opts(int argc, char* argv[], size_t* len, unsigned char** domain, int* lock) {
-
-    const char opt_help[]   = "-h";
-    const char opt_length[] = "-length=";
-    const char opt_domain[] = "-domain=";
-    const char opt_nolock[] = "-nolock";
+int get_opts(int argc, char* argv[], struct OPTS* opts) {
+
+    const char opt_help[]     = "-h";
+    const char opt_length[]   = "-length=";
+    const char opt_domain[]   = "-domain=";
+    const char opt_nolock[]   = "-nolock";
+    const char opt_batch[]    = "-batch=";
+    const char opt_masterfd[] = "-masterfd=";
+    const char opt_keyring[]  = "-keyring";
+    const char opt_forget[]   = "-forget";
+    const char opt_pipeline[] = "-pipeline";
+    const char opt_procs[]    = "-procs=";
+    const char opt_stats[]    = "-stats";
+    const char opt_output[]   = "-output=";
+    const char opt_flush[]    = "-flush=";
+    const char opt_md5sum[]   = "-md5sum=";
+    const char opt_since[]    = "-since=";
+    const char opt_measure[]  = "-measure";
+    const char opt_dedup[]    = "-dedup";
+    const char opt_normalize[] = "-normalize";
+    const char opt_verify[]   = "-verify";
+    const char opt_coalesce[] = "-coalesce";
+    const char opt_checkpoint[] = "-checkpoint=";
+    const char opt_ckpt_every[] = "-checkpoint-every=";
+    const char opt_resume[]   = "-resume";
+    const char opt_uring[]    = "-uring";
 
     int i;
     for (i = 1; i < argc; i++) {
         if (str_diffn(argv[i], opt_help, sizeof(opt_help)-1) == 0) {
             return osexit(0, USAGE);
         } else if (str_diffn(argv[i], opt_nolock, sizeof(opt_nolock)-1) == 0) {
-            *lock = 0;
+            opts->lock = 0;
         } else if (str_diffn(argv[i], opt_length, sizeof(opt_length)-1) == 0) {
-            unsigned long l = 0;
+            const char* l = &argv[i][sizeof(opt_length)-1];
             if (str_len(argv[i]) <= sizeof(opt_length)-1) {
                 return osexit(1, "error: missing argument for -length");
             }
-            if (scan_ulong(&argv[i][sizeof(opt_length)-1], &l) == 0) {
-                return osexit(1, "error: can't parse given -length");
+            if (parse_lengths(l, str_len(l), &opts->lengths) == 0) {
+                return osexit(1, "error: given -length must be >= 4 and <= 24");
             }
-            *len = (size_t)l;
         } else if (str_diffn(argv[i], opt_domain, sizeof(opt_domain)-1) == 0) {
             if (str_len(argv[i]) <= sizeof(opt_domain)-1) {
                 return osexit(1, "error: missing argument for -domain");
             }
-            *domain = (unsigned char*)&argv[i][sizeof(opt_domain)-1];
-        }
-    }
-    return 0;
-}
-
-int read_pw(int fd, unsigned char* pw, size_t max_len) {
-
-    int n;
-
-    if (posix_isatty(fd)) {
-        posix_write(2, PROMPT, sizeof(PROMPT)-1);
-        posix_fsync(2);
-        tty_echo(fd, 0);
-    }
-
-    n = (int)posix_read(fd, pw, max_len);
-
-    if (posix_isatty(fd)) {
-        tty_echo(fd, 1);
-    }
-
-    if (n == -1) {
-        return osexit(2, "error: reading pw");
-    }
-
-    // scan backward for lf/cr aka 'the enter'
-    for(; n > 0; n--) {
-        if (!(pw[n-1] == '\n' || pw[n-1] == '\r')) {
-            break;
-        }
-    }
-
-    if (n == 0) {
-        return osexit(2, "error: pw empty");
-    }
-
-    // the given buffer is essentially one byte larger
-    // than the maximum allowed passphrase length.
-    // if we were able to read max_len bytes, the
-    // passphrase exceeds the maximum passphrase length.
-    // a) due to the limit of the design of csgp we won't
-    //    be able to handle more bytes
-    // b) we don't want to write the superflouse bytes to
-    //    stdout where they would become part of the next
-    //    command and thus leak information.
-    // thus, we flush stdin, zero the already read password
-    // and exit with an error
-    if (n == max_len) {
-        if (posix_isatty(fd)) {
-            discard_fd(fd);
-        }
-        byte_zero(pw, max_len);
-        return osexit(2, "the passphrase is longer than 24 bytes.");
-    }
-
-    return n;
-}
-
-// checks the first 'length' bytes of 'pw' if they
-// are valid under the rules of supergenpass.com:
-//
-// 1. first char is a lowercase letter [a-z]
-// 2. there is at least one uppercase letter [A-Z]
-// 3. there is at least one digit [0-9]
-int is_valid(const unsigned char* pw, size_t len) {
-    unsigned int mask = 0;
-    if (!(*pw >= 'a' && *pw <= 'z')) {
-        return 0;
-    }
-    for (; len > 0; pw++, len--) {
-        if ((*pw >= 'A') && (*pw <= 'Z')) {
-            mask |= 1;
-        } else if ((*pw >= '0') && (*pw <= '9')) {
-            mask |= 2;
-        }
-        if (mask == 3) {
-            return 1;
+            opts->domain = (unsigned char*)&argv[i][sizeof(opt_domain)-1];
+        } else if (str_diffn(argv[i], opt_batch, sizeof(opt_batch)-1) == 0) {
+            if (str_len(argv[i]) <= sizeof(opt_batch)-1) {
+                return osexit(1, "error: missing argument for -batch");
+            }
+            opts->batch = &argv[i][sizeof(opt_batch)-1];
+        } else if (str_diffn(argv[i], opt_masterfd, sizeof(opt_masterfd)-1) == 0) {
+            unsigned long fd = 0;
+            if (scan_ulong(&argv[i][sizeof(opt_masterfd)-1], &fd) == 0) {
+                return osexit(1, "error: can't parse given -masterfd");
+            }
+            opts->master_fd = (int)fd;
+        } else if (str_diffn(argv[i], opt_keyring, sizeof(opt_keyring)-1) == 0) {
+            unsigned long t = DEFAULT_KEYRING_TIMEOUT;
+            if (argv[i][sizeof(opt_keyring)-1] == '=') {
+                if (scan_ulong(&argv[i][sizeof(opt_keyring)], &t) == 0 || t == 0) {
+                    return osexit(1, "error: can't parse given -keyring");
+                }
+            } else if (argv[i][sizeof(opt_keyring)-1] != 0) {
+                continue;
+            }
+            opts->keyring = (unsigned int)t;
+        } else if (str_diffn(argv[i], opt_forget, sizeof(opt_forget)-1) == 0) {
+            opts->forget = 1;
+        } else if (str_diffn(argv[i], opt_pipeline, sizeof(opt_pipeline)-1) == 0) {
+            opts->pipeline = 1;
+        } else if (str_diffn(argv[i], opt_procs, sizeof(opt_procs)-1) == 0) {
+            if (scan_ulong(&argv[i][sizeof(opt_procs)-1], &opts->procs) == 0 || opts->procs == 0) {
+                return osexit(1, "error: can't parse given -procs");
+            }
+        } else if (str_diffn(argv[i], opt_stats, sizeof(opt_stats)-1) == 0) {
+            opts->stats = 1;
+        } else if (str_diffn(argv[i], opt_output, sizeof(opt_output)-1) == 0) {
+            const char* o = &argv[i][sizeof(opt_output)-1];
+            if (str_diff(o, "bin") == 0) {
+                opts->output = OUTPUT_BIN;
+            } else if (str_diff(o, "text") == 0) {
+                opts->output = OUTPUT_TEXT;
+            } else {
+                return osexit(1, "error: -output must be 'text' or 'bin'");
+            }
+        } else if (str_diffn(argv[i], opt_flush, sizeof(opt_flush)-1) == 0) {
+            if (scan_ulong(&argv[i][sizeof(opt_flush)-1], &opts->flush) == 0) {
+                return osexit(1, "error: can't parse given -flush");
+            }
+        } else if (str_diffn(argv[i], opt_md5sum, sizeof(opt_md5sum)-1) == 0) {
+            if (str_len(argv[i]) <= sizeof(opt_md5sum)-1) {
+                return osexit(1, "error: missing argument for -md5sum");
+            }
+            opts->md5sum = &argv[i][sizeof(opt_md5sum)-1];
+        } else if (str_diffn(argv[i], opt_since, sizeof(opt_since)-1) == 0) {
+            if (str_len(argv[i]) <= sizeof(opt_since)-1) {
+                return osexit(1, "error: missing argument for -since");
+            }
+            opts->since = &argv[i][sizeof(opt_since)-1];
+        } else if (str_diffn(argv[i], opt_measure, sizeof(opt_measure)-1) == 0) {
+            unsigned long n = DEFAULT_MEASURE_RUNS;
+            if (argv[i][sizeof(opt_measure)-1] == '=') {
+                if (scan_ulong(&argv[i][sizeof(opt_measure)], &n) == 0 || n == 0) {
+                    return osexit(1, "error: can't parse given -measure");
+                }
+            } else if (argv[i][sizeof(opt_measure)-1] != 0) {
+                continue;
+            }
+            opts->measure = n;
+        } else if (str_diffn(argv[i], opt_dedup, sizeof(opt_dedup)-1) == 0) {
+            unsigned long n = DEFAULT_DEDUP_ENTRIES;
+            if (argv[i][sizeof(opt_dedup)-1] == '=') {
+                if (scan_ulong(&argv[i][sizeof(opt_dedup)], &n) == 0 || n == 0) {
+                    return osexit(1, "error: can't parse given -dedup");
+                }
+            } else if (argv[i][sizeof(opt_dedup)-1] != 0) {
+                continue;
+            }
+            opts->dedup = n;
+        } else if (str_diffn(argv[i], opt_normalize, sizeof(opt_normalize)-1) == 0) {
+            opts->normalize = 1;
+        } else if (str_diffn(argv[i], opt_verify, sizeof(opt_verify)-1) == 0) {
+            opts->verify = 1;
+        } else if (str_diffn(argv[i], opt_coalesce, sizeof(opt_coalesce)-1) == 0) {
+            unsigned long us = DEFAULT_COALESCE_US;
+            if (argv[i][sizeof(opt_coalesce)-1] == '=') {
+                if (scan_ulong(&argv[i][sizeof(opt_coalesce)], &us) == 0 || us == 0) {
+                    return osexit(1, "error: can't parse given -coalesce");
+                }
+            } else if (argv[i][sizeof(opt_coalesce)-1] != 0) {
+                continue;
+            }
+            opts->coalesce = us;
+        } else if (str_diffn(argv[i], opt_checkpoint, sizeof(opt_checkpoint)-1) == 0) {
+            if (str_len(argv[i]) <= sizeof(opt_checkpoint)-1) {
+                return osexit(1, "error: missing argument for -checkpoint");
+            }
+            opts->checkpoint = &argv[i][sizeof(opt_checkpoint)-1];
+        } else if (str_diffn(argv[i], opt_ckpt_every, sizeof(opt_ckpt_every)-1) == 0) {
+            if (scan_ulong(&argv[i][sizeof(opt_ckpt_every)-1], &opts->checkpoint_every) == 0 || opts->checkpoint_every == 0) {
+                return osexit(1, "error: can't parse given -checkpoint-every");
+            }
+        } else if (str_diffn(argv[i], opt_resume, sizeof(opt_resume)-1) == 0) {
+            opts->resume = 1;
+        } else if (str_diffn(argv[i], opt_uring, sizeof(opt_uring)-1) == 0) {
+            opts->uring = 1;
         }
     }
     return 0;
 }
-
@@ -79,11 +79,12 @@ void md5_update(md5Context* ctx, const unsigned char input[], size_t len) {
             have = 0;
         }
 
-        /* Process data in MD5_BLOCK_LENGTH-byte chunks. */
-        while (len >= MD5_BLOCK_LENGTH) {
-            md5_transform(ctx->state, input);
-            input += MD5_BLOCK_LENGTH;
-            len -= MD5_BLOCK_LENGTH;
+        /* Process data in MD5_BLOCK_LENGTH-byte chunks, directly
+           from 'input'. */
+        if (len >= MD5_BLOCK_LENGTH) {
+            md5_blocks(ctx->state, input, len / MD5_BLOCK_LENGTH);
+            input += len & ~(size_t)(MD5_BLOCK_LENGTH - 1);
+            len &= (MD5_BLOCK_LENGTH - 1);
         }
     }
 
@@ -141,102 +142,307 @@ void md5_final(unsigned char digest[MD5_DIGEST_LENGTH], md5Context *ctx) {
 #define MD5STEP(f, w, x, y, z, data, s) \
     ( w += f(x, y, z) + data,  w = w<<s | w>>(32-s),  w += x )
 
+/* Little endian 32bit load from a (possibly unaligned) byte pointer.
+   Compilers turn this into a single load on little endian CPUs. */
+#define GET_32BIT_LE(cp) (                    \
+    (unsigned int)((cp)[0])       |           \
+    (unsigned int)((cp)[1]) <<  8 |           \
+    (unsigned int)((cp)[2]) << 16 |           \
+    (unsigned int)((cp)[3]) << 24)
+
 /*------------------------------------------------------------------*\
    The core of the MD5 algorithm, this alters an existing MD5 hash to
    reflect the addition of 16 longwords of new data.  MD5Update blocks
    the data and converts bytes into longwords for this routine.
+
+   The words are read straight from 'block', which needs no alignment.
+   'n' blocks are processed in a row, the state stays in registers.
 \*------------------------------------------------------------------*/
+void md5_blocks(unsigned int state[4], const unsigned char* block, size_t n) {
+
+    unsigned int a, b, c, d;
+    unsigned int sa = state[0], sb = state[1], sc = state[2], sd = state[3];
+
+#define in(i) GET_32BIT_LE(block + ((i) * 4))
+
+    for (; n > 0; n--, block += MD5_BLOCK_LENGTH) {
+
+        a = sa;
+        b = sb;
+        c = sc;
+        d = sd;
+
+        MD5STEP(F1, a, b, c, d, in( 0) + 0xd76aa478,  7);
+        MD5STEP(F1, d, a, b, c, in( 1) + 0xe8c7b756, 12);
+        MD5STEP(F1, c, d, a, b, in( 2) + 0x242070db, 17);
+        MD5STEP(F1, b, c, d, a, in( 3) + 0xc1bdceee, 22);
+        MD5STEP(F1, a, b, c, d, in( 4) + 0xf57c0faf,  7);
+        MD5STEP(F1, d, a, b, c, in( 5) + 0x4787c62a, 12);
+        MD5STEP(F1, c, d, a, b, in( 6) + 0xa8304613, 17);
+        MD5STEP(F1, b, c, d, a, in( 7) + 0xfd469501, 22);
+        MD5STEP(F1, a, b, c, d, in( 8) + 0x698098d8,  7);
+        MD5STEP(F1, d, a, b, c, in( 9) + 0x8b44f7af, 12);
+        MD5STEP(F1, c, d, a, b, in(10) + 0xffff5bb1, 17);
+        MD5STEP(F1, b, c, d, a, in(11) + 0x895cd7be, 22);
+        MD5STEP(F1, a, b, c, d, in(12) + 0x6b901122,  7);
+        MD5STEP(F1, d, a, b, c, in(13) + 0xfd987193, 12);
+        MD5STEP(F1, c, d, a, b, in(14) + 0xa679438e, 17);
+        MD5STEP(F1, b, c, d, a, in(15) + 0x49b40821, 22);
+
+        MD5STEP(F2, a, b, c, d, in( 1) + 0xf61e2562,  5);
+        MD5STEP(F2, d, a, b, c, in( 6) + 0xc040b340,  9);
+        MD5STEP(F2, c, d, a, b, in(11) + 0x265e5a51, 14);
+        MD5STEP(F2, b, c, d, a, in( 0) + 0xe9b6c7aa, 20);
+        MD5STEP(F2, a, b, c, d, in( 5) + 0xd62f105d,  5);
+        MD5STEP(F2, d, a, b, c, in(10) + 0x02441453,  9);
+        MD5STEP(F2, c, d, a, b, in(15) + 0xd8a1e681, 14);
+        MD5STEP(F2, b, c, d, a, in( 4) + 0xe7d3fbc8, 20);
+        MD5STEP(F2, a, b, c, d, in( 9) + 0x21e1cde6,  5);
+        MD5STEP(F2, d, a, b, c, in(14) + 0xc33707d6,  9);
+        MD5STEP(F2, c, d, a, b, in( 3) + 0xf4d50d87, 14);
+        MD5STEP(F2, b, c, d, a, in( 8) + 0x455a14ed, 20);
+        MD5STEP(F2, a, b, c, d, in(13) + 0xa9e3e905,  5);
+        MD5STEP(F2, d, a, b, c, in( 2) + 0xfcefa3f8,  9);
+        MD5STEP(F2, c, d, a, b, in( 7) + 0x676f02d9, 14);
+        MD5STEP(F2, b, c, d, a, in(12) + 0x8d2a4c8a, 20);
+
+        MD5STEP(F3, a, b, c, d, in( 5) + 0xfffa3942,  4);
+        MD5STEP(F3, d, a, b, c, in( 8) + 0x8771f681, 11);
+        MD5STEP(F3, c, d, a, b, in(11) + 0x6d9d6122, 16);
+        MD5STEP(F3, b, c, d, a, in(14) + 0xfde5380c, 23);
+        MD5STEP(F3, a, b, c, d, in( 1) + 0xa4beea44,  4);
+        MD5STEP(F3, d, a, b, c, in( 4) + 0x4bdecfa9, 11);
+        MD5STEP(F3, c, d, a, b, in( 7) + 0xf6bb4b60, 16);
+        MD5STEP(F3, b, c, d, a, in(10) + 0xbebfbc70, 23);
+        MD5STEP(F3, a, b, c, d, in(13) + 0x289b7ec6,  4);
+        MD5STEP(F3, d, a, b, c, in( 0) + 0xeaa127fa, 11);
+        MD5STEP(F3, c, d, a, b, in( 3) + 0xd4ef3085, 16);
+        MD5STEP(F3, b, c, d, a, in( 6) + 0x04881d05, 23);
+        MD5STEP(F3, a, b, c, d, in( 9) + 0xd9d4d039,  4);
+        MD5STEP(F3, d, a, b, c, in(12) + 0xe6db99e5, 11);
+        MD5STEP(F3, c, d, a, b, in(15) + 0x1fa27cf8, 16);
+        MD5STEP(F3, b, c, d, a, in( 2) + 0xc4ac5665, 23);
+
+        MD5STEP(F4, a, b, c, d, in( 0) + 0xf4292244,  6);
+        MD5STEP(F4, d, a, b, c, in( 7) + 0x432aff97, 10);
+        MD5STEP(F4, c, d, a, b, in(14) + 0xab9423a7, 15);
+        MD5STEP(F4, b, c, d, a, in( 5) + 0xfc93a039, 21);
+        MD5STEP(F4, a, b, c, d, in(12) + 0x655b59c3,  6);
+        MD5STEP(F4, d, a, b, c, in( 3) + 0x8f0ccc92, 10);
+        MD5STEP(F4, c, d, a, b, in(10) + 0xffeff47d, 15);
+        MD5STEP(F4, b, c, d, a, in( 1) + 0x85845dd1, 21);
+        MD5STEP(F4, a, b, c, d, in( 8) + 0x6fa87e4f,  6);
+        MD5STEP(F4, d, a, b, c, in(15) + 0xfe2ce6e0, 10);
+        MD5STEP(F4, c, d, a, b, in( 6) + 0xa3014314, 15);
+        MD5STEP(F4, b, c, d, a, in(13) + 0x4e0811a1, 21);
+        MD5STEP(F4, a, b, c, d, in( 4) + 0xf7537e82,  6);
+        MD5STEP(F4, d, a, b, c, in(11) + 0xbd3af235, 10);
+        MD5STEP(F4, c, d, a, b, in( 2) + 0x2ad7d2bb, 15);
+        MD5STEP(F4, b, c, d, a, in( 9) + 0xeb86d391, 21);
+
+        sa += a;
+        sb += b;
+        sc += c;
+        sd += d;
+    }
+
+#undef in
+
+    state[0] = sa;
+    state[1] = sb;
+    state[2] = sc;
+    state[3] = sd;
+}
+
 void md5_transform(unsigned int state[4], const unsigned char block[MD5_BLOCK_LENGTH]) {
+    md5_blocks(state, block, 1);
+}
 
-    unsigned int a, b, c, d, in[MD5_BLOCK_LENGTH / 4];
+/*------------------------------------------------------------------*\
+   Puts what a copy of 'ctx' plus 'n' more bytes still has to hash
+   into 'block' in one go: the bytes buffered in 'ctx', 'msg', the
+   padding and the bit count. none of the buffering of md5_update()
+   and md5_pad(). returns the number of blocks, 1 or 2, and 0 if the
+   rest does not fit into two blocks. 'ctx' is not touched.
+\*------------------------------------------------------------------*/
+size_t md5_short_pad(unsigned char block[2 * MD5_BLOCK_LENGTH], const md5Context* ctx,
+    const unsigned char* msg, size_t n) {
 
-#if BYTE_ORDER == LITTLE_ENDIAN
-    byte_copy(in, sizeof(in), block);
-#else
-    for (a = 0; a < MD5_BLOCK_LENGTH / 4; a++) {
-        in[a] = (unsigned int)(
-            (unsigned int)(block[a * 4 + 0]) |
-            (unsigned int)(block[a * 4 + 1]) <<  8 |
-            (unsigned int)(block[a * 4 + 2]) << 16 |
-            (unsigned int)(block[a * 4 + 3]) << 24);
+    unsigned long long bits = ctx->count + ((unsigned long long)n << 3);
+    size_t have = (size_t)((ctx->count >> 3) & (MD5_BLOCK_LENGTH - 1));
+    size_t len;
+
+    if (have + n > MD5_SHORT_MAX) {
+        return 0;
+    }
+    len = (have + n + 1 + 8 <= MD5_BLOCK_LENGTH) ? MD5_BLOCK_LENGTH : 2 * MD5_BLOCK_LENGTH;
+
+    byte_copy(block, have, ctx->buffer);
+    byte_copy(block + have, n, msg);
+    block[have + n] = 0x80;
+    byte_zero(block + have + n + 1, len - 8 - (have + n + 1));
+    PUT_64BIT_LE(block + len - 8, bits);
+    return len / MD5_BLOCK_LENGTH;
+}
+
+/*------------------------------------------------------------------*\
+   md5_final() of a copy of 'ctx' plus 'n' more bytes, via
+   md5_short_pad(). returns 0 if that does not fit.
+\*------------------------------------------------------------------*/
+int md5_short(unsigned char digest[MD5_DIGEST_LENGTH], const md5Context* ctx,
+    const unsigned char* msg, size_t n) {
+
+    unsigned char block[2 * MD5_BLOCK_LENGTH];
+    unsigned int state[4];
+    size_t blocks, i;
+
+    blocks = md5_short_pad(block, ctx, msg, n);
+    if (blocks == 0) {
+        return 0;
+    }
+    for (i = 0; i < 4; i++) {
+        state[i] = ctx->state[i];
     }
+    md5_blocks(state, block, blocks);
+    for (i = 0; i < 4; i++) {
+        PUT_32BIT_LE(digest + i * 4, state[i]);
+    }
+
+    byte_zero(block, sizeof(block));
+    byte_zero(state, sizeof(state));
+    return 1;
+}
+
+/*------------------------------------------------------------------*\
+   MD5_LANES independent md5_transform()s, interleaved step by step.
+   every MD5STEP depends on the one before, a single chain leaves most
+   of a superscalar cpu idle. the steps of the other lanes fill the
+   gaps. plain c, no intrinsics: it is up to the out-of-order core.
+\*------------------------------------------------------------------*/
+
+#if MD5_LANES < 1 || MD5_LANES > 4
+#error "MD5_LANES must be 1, 2, 3 or 4"
+#endif
+
+#if MD5_LANES >= 2
+#define LANE1(...) __VA_ARGS__
+#else
+#define LANE1(...)
+#endif
+#if MD5_LANES >= 3
+#define LANE2(...) __VA_ARGS__
+#else
+#define LANE2(...)
+#endif
+#if MD5_LANES >= 4
+#define LANE3(...) __VA_ARGS__
+#else
+#define LANE3(...)
 #endif
 
-    a = state[0];
-    b = state[1];
-    c = state[2];
-    d = state[3];
-
-    MD5STEP(F1, a, b, c, d, in[ 0] + 0xd76aa478,  7);
-    MD5STEP(F1, d, a, b, c, in[ 1] + 0xe8c7b756, 12);
-    MD5STEP(F1, c, d, a, b, in[ 2] + 0x242070db, 17);
-    MD5STEP(F1, b, c, d, a, in[ 3] + 0xc1bdceee, 22);
-    MD5STEP(F1, a, b, c, d, in[ 4] + 0xf57c0faf,  7);
-    MD5STEP(F1, d, a, b, c, in[ 5] + 0x4787c62a, 12);
-    MD5STEP(F1, c, d, a, b, in[ 6] + 0xa8304613, 17);
-    MD5STEP(F1, b, c, d, a, in[ 7] + 0xfd469501, 22);
-    MD5STEP(F1, a, b, c, d, in[ 8] + 0x698098d8,  7);
-    MD5STEP(F1, d, a, b, c, in[ 9] + 0x8b44f7af, 12);
-    MD5STEP(F1, c, d, a, b, in[10] + 0xffff5bb1, 17);
-    MD5STEP(F1, b, c, d, a, in[11] + 0x895cd7be, 22);
-    MD5STEP(F1, a, b, c, d, in[12] + 0x6b901122,  7);
-    MD5STEP(F1, d, a, b, c, in[13] + 0xfd987193, 12);
-    MD5STEP(F1, c, d, a, b, in[14] + 0xa679438e, 17);
-    MD5STEP(F1, b, c, d, a, in[15] + 0x49b40821, 22);
-
-    MD5STEP(F2, a, b, c, d, in[ 1] + 0xf61e2562,  5);
-    MD5STEP(F2, d, a, b, c, in[ 6] + 0xc040b340,  9);
-    MD5STEP(F2, c, d, a, b, in[11] + 0x265e5a51, 14);
-    MD5STEP(F2, b, c, d, a, in[ 0] + 0xe9b6c7aa, 20);
-    MD5STEP(F2, a, b, c, d, in[ 5] + 0xd62f105d,  5);
-    MD5STEP(F2, d, a, b, c, in[10] + 0x02441453,  9);
-    MD5STEP(F2, c, d, a, b, in[15] + 0xd8a1e681, 14);
-    MD5STEP(F2, b, c, d, a, in[ 4] + 0xe7d3fbc8, 20);
-    MD5STEP(F2, a, b, c, d, in[ 9] + 0x21e1cde6,  5);
-    MD5STEP(F2, d, a, b, c, in[14] + 0xc33707d6,  9);
-    MD5STEP(F2, c, d, a, b, in[ 3] + 0xf4d50d87, 14);
-    MD5STEP(F2, b, c, d, a, in[ 8] + 0x455a14ed, 20);
-    MD5STEP(F2, a, b, c, d, in[13] + 0xa9e3e905,  5);
-    MD5STEP(F2, d, a, b, c, in[ 2] + 0xfcefa3f8,  9);
-    MD5STEP(F2, c, d, a, b, in[ 7] + 0x676f02d9, 14);
-    MD5STEP(F2, b, c, d, a, in[12] + 0x8d2a4c8a, 20);
-
-    MD5STEP(F3, a, b, c, d, in[ 5] + 0xfffa3942,  4);
-    MD5STEP(F3, d, a, b, c, in[ 8] + 0x8771f681, 11);
-    MD5STEP(F3, c, d, a, b, in[11] + 0x6d9d6122, 16);
-    MD5STEP(F3, b, c, d, a, in[14] + 0xfde5380c, 23);
-    MD5STEP(F3, a, b, c, d, in[ 1] + 0xa4beea44,  4);
-    MD5STEP(F3, d, a, b, c, in[ 4] + 0x4bdecfa9, 11);
-    MD5STEP(F3, c, d, a, b, in[ 7] + 0xf6bb4b60, 16);
-    MD5STEP(F3, b, c, d, a, in[10] + 0xbebfbc70, 23);
-    MD5STEP(F3, a, b, c, d, in[13] + 0x289b7ec6,  4);
-    MD5STEP(F3, d, a, b, c, in[ 0] + 0xeaa127fa, 11);
-    MD5STEP(F3, c, d, a, b, in[ 3] + 0xd4ef3085, 16);
-    MD5STEP(F3, b, c, d, a, in[ 6] + 0x04881d05, 23);
-    MD5STEP(F3, a, b, c, d, in[ 9] + 0xd9d4d039,  4);
-    MD5STEP(F3, d, a, b, c, in[12] + 0xe6db99e5, 11);
-    MD5STEP(F3, c, d, a, b, in[15] + 0x1fa27cf8, 16);
-    MD5STEP(F3, b, c, d, a, in[2 ] + 0xc4ac5665, 23);
-
-    MD5STEP(F4, a, b, c, d, in[ 0] + 0xf4292244,  6);
-    MD5STEP(F4, d, a, b, c, in[7 ] + 0x432aff97, 10);
-    MD5STEP(F4, c, d, a, b, in[14] + 0xab9423a7, 15);
-    MD5STEP(F4, b, c, d, a, in[5 ] + 0xfc93a039, 21);
-    MD5STEP(F4, a, b, c, d, in[12] + 0x655b59c3,  6);
-    MD5STEP(F4, d, a, b, c, in[3 ] + 0x8f0ccc92, 10);
-    MD5STEP(F4, c, d, a, b, in[10] + 0xffeff47d, 15);
-    MD5STEP(F4, b, c, d, a, in[1 ] + 0x85845dd1, 21);
-    MD5STEP(F4, a, b, c, d, in[8 ] + 0x6fa87e4f,  6);
-    MD5STEP(F4, d, a, b, c, in[15] + 0xfe2ce6e0, 10);
-    MD5STEP(F4, c, d, a, b, in[6 ] + 0xa3014314, 15);
-    MD5STEP(F4, b, c, d, a, in[13] + 0x4e0811a1, 21);
-    MD5STEP(F4, a, b, c, d, in[4 ] + 0xf7537e82,  6);
-    MD5STEP(F4, d, a, b, c, in[11] + 0xbd3af235, 10);
-    MD5STEP(F4, c, d, a, b, in[2 ] + 0x2ad7d2bb, 15);
-    MD5STEP(F4, b, c, d, a, in[9 ] + 0xeb86d391, 21);
-
-    state[0] += a;
-    state[1] += b;
-    state[2] += c;
-    state[3] += d;
+#define STEP_LANES(f, w, x, y, z, i, k, s) do {                              \
+    MD5STEP(f, w##0, x##0, y##0, z##0, GET_32BIT_LE(p0 + (i) * 4) + k, s);   \
+    LANE1(MD5STEP(f, w##1, x##1, y##1, z##1, GET_32BIT_LE(p1 + (i) * 4) + k, s);) \
+    LANE2(MD5STEP(f, w##2, x##2, y##2, z##2, GET_32BIT_LE(p2 + (i) * 4) + k, s);) \
+    LANE3(MD5STEP(f, w##3, x##3, y##3, z##3, GET_32BIT_LE(p3 + (i) * 4) + k, s);) \
+    } while (0)
+
+#define LOAD_LANE(l)                   \
+    a##l = state[l][0];                \
+    b##l = state[l][1];                \
+    c##l = state[l][2];                \
+    d##l = state[l][3];                \
+    p##l = block[l];
+
+#define STORE_LANE(l)                  \
+    state[l][0] += a##l;               \
+    state[l][1] += b##l;               \
+    state[l][2] += c##l;               \
+    state[l][3] += d##l;
+
+void md5_transform_lanes(unsigned int state[MD5_LANES][4], const unsigned char* const block[MD5_LANES]) {
+
+    unsigned int a0, b0, c0, d0;
+    const unsigned char* p0;
+    LANE1(unsigned int a1, b1, c1, d1; const unsigned char* p1;)
+    LANE2(unsigned int a2, b2, c2, d2; const unsigned char* p2;)
+    LANE3(unsigned int a3, b3, c3, d3; const unsigned char* p3;)
+
+    LOAD_LANE(0)
+    LANE1(LOAD_LANE(1))
+    LANE2(LOAD_LANE(2))
+    LANE3(LOAD_LANE(3))
+
+    STEP_LANES(F1, a, b, c, d,  0, 0xd76aa478,  7);
+    STEP_LANES(F1, d, a, b, c,  1, 0xe8c7b756, 12);
+    STEP_LANES(F1, c, d, a, b,  2, 0x242070db, 17);
+    STEP_LANES(F1, b, c, d, a,  3, 0xc1bdceee, 22);
+    STEP_LANES(F1, a, b, c, d,  4, 0xf57c0faf,  7);
+    STEP_LANES(F1, d, a, b, c,  5, 0x4787c62a, 12);
+    STEP_LANES(F1, c, d, a, b,  6, 0xa8304613, 17);
+    STEP_LANES(F1, b, c, d, a,  7, 0xfd469501, 22);
+    STEP_LANES(F1, a, b, c, d,  8, 0x698098d8,  7);
+    STEP_LANES(F1, d, a, b, c,  9, 0x8b44f7af, 12);
+    STEP_LANES(F1, c, d, a, b, 10, 0xffff5bb1, 17);
+    STEP_LANES(F1, b, c, d, a, 11, 0x895cd7be, 22);
+    STEP_LANES(F1, a, b, c, d, 12, 0x6b901122,  7);
+    STEP_LANES(F1, d, a, b, c, 13, 0xfd987193, 12);
+    STEP_LANES(F1, c, d, a, b, 14, 0xa679438e, 17);
+    STEP_LANES(F1, b, c, d, a, 15, 0x49b40821, 22);
+
+    STEP_LANES(F2, a, b, c, d,  1, 0xf61e2562,  5);
+    STEP_LANES(F2, d, a, b, c,  6, 0xc040b340,  9);
+    STEP_LANES(F2, c, d, a, b, 11, 0x265e5a51, 14);
+    STEP_LANES(F2, b, c, d, a,  0, 0xe9b6c7aa, 20);
+    STEP_LANES(F2, a, b, c, d,  5, 0xd62f105d,  5);
+    STEP_LANES(F2, d, a, b, c, 10, 0x02441453,  9);
+    STEP_LANES(F2, c, d, a, b, 15, 0xd8a1e681, 14);
+    STEP_LANES(F2, b, c, d, a,  4, 0xe7d3fbc8, 20);
+    STEP_LANES(F2, a, b, c, d,  9, 0x21e1cde6,  5);
+    STEP_LANES(F2, d, a, b, c, 14, 0xc33707d6,  9);
+    STEP_LANES(F2, c, d, a, b,  3, 0xf4d50d87, 14);
+    STEP_LANES(F2, b, c, d, a,  8, 0x455a14ed, 20);
+    STEP_LANES(F2, a, b, c, d, 13, 0xa9e3e905,  5);
+    STEP_LANES(F2, d, a, b, c,  2, 0xfcefa3f8,  9);
+    STEP_LANES(F2, c, d, a, b,  7, 0x676f02d9, 14);
+    STEP_LANES(F2, b, c, d, a, 12, 0x8d2a4c8a, 20);
+
+    STEP_LANES(F3, a, b, c, d,  5, 0xfffa3942,  4);
+    STEP_LANES(F3, d, a, b, c,  8, 0x8771f681, 11);
+    STEP_LANES(F3, c, d, a, b, 11, 0x6d9d6122, 16);
+    STEP_LANES(F3, b, c, d, a, 14, 0xfde5380c, 23);
+    STEP_LANES(F3, a, b, c, d,  1, 0xa4beea44,  4);
+    STEP_LANES(F3, d, a, b, c,  4, 0x4bdecfa9, 11);
+    STEP_LANES(F3, c, d, a, b,  7, 0xf6bb4b60, 16);
+    STEP_LANES(F3, b, c, d, a, 10, 0xbebfbc70, 23);
+    STEP_LANES(F3, a, b, c, d, 13, 0x289b7ec6,  4);
+    STEP_LANES(F3, d, a, b, c,  0, 0xeaa127fa, 11);
+    STEP_LANES(F3, c, d, a, b,  3, 0xd4ef3085, 16);
+    STEP_LANES(F3, b, c, d, a,  6, 0x04881d05, 23);
+    STEP_LANES(F3, a, b, c, d,  9, 0xd9d4d039,  4);
+    STEP_LANES(F3, d, a, b, c, 12, 0xe6db99e5, 11);
+    STEP_LANES(F3, c, d, a, b, 15, 0x1fa27cf8, 16);
+    STEP_LANES(F3, b, c, d, a,  2, 0xc4ac5665, 23);
+
+    STEP_LANES(F4, a, b, c, d,  0, 0xf4292244,  6);
+    STEP_LANES(F4, d, a, b, c,  7, 0x432aff97, 10);
+    STEP_LANES(F4, c, d, a, b, 14, 0xab9423a7, 15);
+    STEP_LANES(F4, b, c, d, a,  5, 0xfc93a039, 21);
+    STEP_LANES(F4, a, b, c, d, 12, 0x655b59c3,  6);
+    STEP_LANES(F4, d, a, b, c,  3, 0x8f0ccc92, 10);
+    STEP_LANES(F4, c, d, a, b, 10, 0xffeff47d, 15);
+    STEP_LANES(F4, b, c, d, a,  1, 0x85845dd1, 21);
+    STEP_LANES(F4, a, b, c, d,  8, 0x6fa87e4f,  6);
+    STEP_LANES(F4, d, a, b, c, 15, 0xfe2ce6e0, 10);
+    STEP_LANES(F4, c, d, a, b,  6, 0xa3014314, 15);
+    STEP_LANES(F4, b, c, d, a, 13, 0x4e0811a1, 21);
+    STEP_LANES(F4, a, b, c, d,  4, 0xf7537e82,  6);
+    STEP_LANES(F4, d, a, b, c, 11, 0xbd3af235, 10);
+    STEP_LANES(F4, c, d, a, b,  2, 0x2ad7d2bb, 15);
+    STEP_LANES(F4, b, c, d, a,  9, 0xeb86d391, 21);
+
+    STORE_LANE(0)
+    LANE1(STORE_LANE(1))
+    LANE2(STORE_LANE(2))
+    LANE3(STORE_LANE(3))
 }
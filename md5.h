@@ -15,9 +15,18 @@
 enum {
     MD5_BLOCK_LENGTH = 64,
     MD5_DIGEST_LENGTH = 16,
-    MD5_DIGEST_STRING_LENGTH = (MD5_DIGEST_LENGTH*2) + 1
+    MD5_DIGEST_STRING_LENGTH = (MD5_DIGEST_LENGTH*2) + 1,
+
+    // md5_short_pad(): two blocks minus the 0x80 and the bit count
+    MD5_SHORT_MAX = (2 * MD5_BLOCK_LENGTH) - 1 - 8
 };
 
+// number of interleaved chains in md5_transform_lanes(), 1..4. fewer
+// lanes for cpus with few registers (i386: -DMD5_LANES=2)
+#ifndef MD5_LANES
+#define MD5_LANES 4
+#endif
+
 typedef struct {
     unsigned int state[4];                   /* state */
     unsigned long long count;                /* number of bits, mod 2^64 */
@@ -28,6 +37,10 @@ extern void md5_init(md5Context*);
 extern void md5_update(md5Context*, const unsigned char[], size_t);
 extern void md5_pad(md5Context*);
 extern void md5_final(unsigned char[MD5_DIGEST_LENGTH], md5Context*);
+extern size_t md5_short_pad(unsigned char[2 * MD5_BLOCK_LENGTH], const md5Context*, const unsigned char*, size_t);
+extern int  md5_short(unsigned char[MD5_DIGEST_LENGTH], const md5Context*, const unsigned char*, size_t);
 extern void md5_transform(unsigned int [4], const unsigned char[MD5_BLOCK_LENGTH]);
+extern void md5_blocks(unsigned int [4], const unsigned char*, size_t n);
+extern void md5_transform_lanes(unsigned int [MD5_LANES][4], const unsigned char* const [MD5_LANES]);
 
 #endif
@@ -0,0 +1,201 @@
+/*------------------------------------------------------------------*\
+
+       file: measure.c
+      about: latency of the stages of one supergenpass() chain
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+   -measure is about one chain, not about throughput: every stage
+   runs 'runs' times in a row on the fixed input of the chain of
+   -domain, the figures are per call:
+
+     stage            ns   cycles    instr  br-miss
+     md5_transform   ...   one round of the chain
+     base64_encode   ...   one digest -> password
+     sgp_valid       ...   one candidate, the check of the kernels
+     chain           ...   all of supergenpass(), ~10 rounds
+
+   the counters come from perf_event_open() (linux, user space only).
+   without them (other systems, perf_event_paranoid, vms without a
+   pmu) only the time is printed.
+
+\*------------------------------------------------------------------*/
+
+#include "measure.h"
+#include "platform.h"
+
+#include "djb/byte.h"
+#include "djb/fmt.h"
+#include "djb/str.h"
+
+enum {
+    MEASURE_TRANSFORM = 0,
+    MEASURE_BASE64,
+    MEASURE_VALID,
+    MEASURE_CHAIN,
+    MEASURE_STAGES,
+
+    MEASURE_NS = PERF_COUNTERS, // after the counters
+};
+
+struct MEASURE {
+    int                 fd[PERF_COUNTERS];
+    int                 hw;     // the counters are available
+    unsigned long long  start[PERF_COUNTERS + 1];
+    unsigned long long  sum[MEASURE_STAGES][PERF_COUNTERS + 1];
+};
+
+/*------------------------------------------------------------------*\
+\*------------------------------------------------------------------*/
+
+static void m_start(struct MEASURE* m) {
+    if (m->hw) {
+        perf_read(m->fd, m->start);
+    }
+    m->start[MEASURE_NS] = posix_now();
+}
+
+static void m_stop(struct MEASURE* m, int stage) {
+
+    unsigned long long v[PERF_COUNTERS + 1];
+    int i;
+
+    v[MEASURE_NS] = posix_now();
+    if (m->hw) {
+        perf_read(m->fd, v);
+    } else {
+        byte_zero(v, sizeof(v[0]) * PERF_COUNTERS);
+    }
+    for (i = 0; i <= PERF_COUNTERS; i++) {
+        m->sum[stage][i] += v[i] - (m->hw || i == MEASURE_NS ? m->start[i] : 0);
+    }
+}
+
+// 'v' right aligned in 'w' columns
+static unsigned int put_col(char* buf, unsigned long v, unsigned int w) {
+
+    char num[FMT_ULONG];
+    unsigned int n = fmt_ulong(num, v);
+    unsigned int i = 0;
+
+    for (; i + n < w; i++) {
+        buf[i] = ' ';
+    }
+    byte_copy(buf + i, n, num);
+    return i + n;
+}
+
+static void print(struct MEASURE* m, unsigned long runs) {
+
+    static const char* names[MEASURE_STAGES] = {
+        "md5_transform", "base64_encode", "sgp_valid", "chain"
+    };
+    char buf[128];
+    unsigned int n, s, i;
+
+    n = 0;
+    byte_copy(buf, 14, "stage         ");
+    n = 14;
+    byte_copy(buf + n, 9, "       ns");
+    n += 9;
+    if (m->hw) {
+        byte_copy(buf + n, 27, "   cycles    instr  br-miss");
+        n += 27;
+    }
+    buf[n++] = '\n';
+    posix_write(1, buf, n);
+
+    for (s = 0; s < MEASURE_STAGES; s++) {
+        n = str_len(names[s]);
+        byte_copy(buf, n, names[s]);
+        for (; n < 14; n++) {
+            buf[n] = ' ';
+        }
+        n += put_col(buf + n, (unsigned long)(m->sum[s][MEASURE_NS] / runs), 9);
+        for (i = 0; m->hw && i < PERF_COUNTERS; i++) {
+            n += put_col(buf + n, (unsigned long)(m->sum[s][i] / runs), 9);
+        }
+        buf[n++] = '\n';
+        posix_write(1, buf, n);
+    }
+}
+
+/*------------------------------------------------------------------*\
+\*------------------------------------------------------------------*/
+
+int measure_run(struct SGP* sgp, unsigned long runs, int lock) {
+
+    struct MEASURE m;
+    md5Context base;    // 'master:', see sgp_prime()
+    unsigned char block[MD5_BLOCK_LENGTH];
+    unsigned char raw[MD5_DIGEST_LENGTH];
+    unsigned int state[4];
+    sgp_valid_fn valid;
+    unsigned long r;
+
+    if (lock) {
+        if (lock_memory(&base, sizeof(base)) != 0 ||
+            lock_memory(block, sizeof(block)) != 0) {
+            return osexit(4, "error: can't lock memory");
+        }
+    }
+
+    byte_zero(&m, sizeof(m));
+    m.hw = (perf_open(m.fd) == 0);
+    if (!m.hw) {
+        posix_write(2, "warning: no hardware counters, time only\n", 41);
+    }
+
+    sgp_prime(&base, sgp->pw, sgp->in_len);
+    byte_zero(sgp->pw, sizeof(sgp->pw));
+
+    // the whole chain, and its result as input for the stages
+    for (r = 0; r < runs; r++) {
+        byte_copy(&sgp->md5, sizeof(base), &base);
+        m_start(&m);
+        supergenpass_primed(sgp);
+        m_stop(&m, MEASURE_CHAIN);
+    }
+
+    // a round hashes the 24 bytes of the password before
+    byte_zero(block, sizeof(block));
+    byte_copy(block, B64_MD5_DIGEST_LENGTH, sgp->pw);
+    block[B64_MD5_DIGEST_LENGTH] = 0x80;
+    block[MD5_BLOCK_LENGTH - 8] = (unsigned char)(B64_MD5_DIGEST_LENGTH * 8);
+    m_start(&m);
+    for (r = 0; r < runs; r++) {
+        md5_init(&sgp->md5);
+        byte_copy(state, sizeof(state), sgp->md5.state);
+        md5_transform(state, block);
+    }
+    m_stop(&m, MEASURE_TRANSFORM);
+
+    byte_copy(raw, sizeof(raw), state);
+    m_start(&m);
+    for (r = 0; r < runs; r++) {
+        base64_encode(sgp->pw, raw, MD5_DIGEST_LENGTH, B64_SGP_TABLE);
+    }
+    m_stop(&m, MEASURE_BASE64);
+
+    valid = sgp_valid(sgp->out_len);
+    m_start(&m);
+    for (r = 0; r < runs; r++) {
+        block[0] ^= (unsigned char)valid(sgp->pw);
+    }
+    m_stop(&m, MEASURE_VALID);
+
+    if (m.hw) {
+        perf_close(m.fd);
+    }
+    print(&m, runs);
+
+    byte_zero(&base, sizeof(base));
+    byte_zero(block, sizeof(block));
+    byte_zero(raw, sizeof(raw));
+    byte_zero(state, sizeof(state));
+    if (lock) {
+        unlock_memory(block, sizeof(block));
+        unlock_memory(&base, sizeof(base));
+    }
+    return 0;
+}
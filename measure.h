@@ -0,0 +1,24 @@
+#ifndef _MEASURE_H_
+#define _MEASURE_H_
+
+/*------------------------------------------------------------------*\
+
+       file: measure.h
+      about: latency of the stages of one supergenpass() chain
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+\*------------------------------------------------------------------*/
+
+#include "sgp.h"
+
+enum {
+    DEFAULT_MEASURE_RUNS = 10000,
+};
+
+// runs every stage of the chain of sgp->domain 'runs' times and
+// prints the time, cycles, instructions and branch misses of one
+// call of each (see measure.c). sgp->pw holds the master.
+extern int measure_run(struct SGP* sgp, unsigned long runs, int lock);
+
+#endif
@@ -0,0 +1,229 @@
+/*------------------------------------------------------------------*\
+
+       file: pipeline.c
+      about: runs the stages of the batch engine concurrently
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+   every stage runs on its own thread, the stages are connected by
+   bounded single-producer/single-consumer queues of chunks:
+
+     q[parse]     -> parse     -> q[normalize]
+     q[normalize] -> normalize -> q[derive]
+     q[derive]    -> derive    -> q[write]
+     q[write]     -> write     -> q[parse]    (the empty chunks)
+
+   only PIPELINE_CHUNKS chunks exist: when a stage is slow, the
+   stages before it run out of empty chunks and wait (back-pressure).
+   the throughput is the one of the slowest stage. a stage which
+   waits spins PIPELINE_SPIN times on its queue and then sleeps on
+   the condition variable of it, the other side wakes it up. derive
+   takes most of the time, the other stages sleep most of the run.
+
+   the chunks hold passwords and masters: they are locked (if
+   b->lock) and zeroed before returning.
+
+   only with -DCSGP_THREADS (and pthreads), otherwise batch_run()
+   runs the stages one after another.
+
+\*------------------------------------------------------------------*/
+
+#include "batch.h"
+#include "platform.h"
+
+#if defined(CSGP_THREADS)
+
+#include "djb/byte.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+enum {
+    PIPELINE_CHUNKS = 4,
+    PIPELINE_QUEUE  = 4, // a power of 2, >= PIPELINE_CHUNKS
+    PIPELINE_SPIN   = 64,
+};
+
+// a full queue has all the chunks, an empty one none: only one side
+// of a queue waits at a time.
+struct QUEUE {
+    atomic_size_t        head; // written by the consumer only
+    atomic_size_t        tail; // written by the producer only
+    struct BATCH_CHUNK*  slot[PIPELINE_QUEUE];
+    atomic_int           sleeping;
+    pthread_mutex_t      lock;
+    pthread_cond_t       wake;
+};
+
+struct STAGE {
+    int                 id;
+    struct BATCH*       b;
+    struct QUEUE*       in;
+    struct QUEUE*       out;
+};
+
+struct PIPELINE {
+    struct QUEUE        q[BATCH_STAGES]; // q[s] feeds stage 's'
+    struct STAGE        stage[BATCH_STAGES];
+    struct BATCH_CHUNK  chunk[PIPELINE_CHUNKS];
+};
+
+/*------------------------------------------------------------------*\
+\*------------------------------------------------------------------*/
+
+// 1 if the producer ('push') or the consumer of 'q' can go on
+static int q_ready(struct QUEUE* q, int push) {
+    size_t n = atomic_load(&q->tail) - atomic_load(&q->head);
+    return push ? (n < PIPELINE_QUEUE) : (n > 0);
+}
+
+// the sleeper sets 'sleeping' before it checks the queue, the other
+// side moves head or tail before it checks 'sleeping' (all seq_cst):
+// one of them sees the other, no wakeup gets lost.
+static void q_wait(struct QUEUE* q, int push) {
+
+    unsigned int spin;
+
+    for (spin = 0; spin < PIPELINE_SPIN; spin++) {
+        if (q_ready(q, push)) {
+            return;
+        }
+    }
+    pthread_mutex_lock(&q->lock);
+    atomic_store(&q->sleeping, 1);
+    while (!q_ready(q, push)) {
+        pthread_cond_wait(&q->wake, &q->lock);
+    }
+    atomic_store(&q->sleeping, 0);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static void q_wake(struct QUEUE* q) {
+    if (atomic_load(&q->sleeping)) {
+        pthread_mutex_lock(&q->lock);
+        pthread_cond_signal(&q->wake);
+        pthread_mutex_unlock(&q->lock);
+    }
+}
+
+static void q_push(struct QUEUE* q, struct BATCH_CHUNK* c) {
+
+    size_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+
+    q_wait(q, 1);
+    q->slot[tail & (PIPELINE_QUEUE - 1)] = c;
+    atomic_store(&q->tail, tail + 1);
+    q_wake(q);
+}
+
+static struct BATCH_CHUNK* q_pop(struct QUEUE* q) {
+
+    size_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    struct BATCH_CHUNK* c;
+
+    q_wait(q, 0);
+    c = q->slot[head & (PIPELINE_QUEUE - 1)];
+    atomic_store(&q->head, head + 1);
+    q_wake(q);
+    return c;
+}
+
+static void* stage_run(void* arg) {
+
+    struct STAGE* s = (struct STAGE*)arg;
+    struct BATCH* b = s->b;
+    struct BATCH_CHUNK* c;
+    unsigned long long t;
+    int eof;
+
+    do {
+        c = q_pop(s->in);
+        t = posix_now();
+        switch (s->id) {
+        case BATCH_PARSE:     batch_fill(b, c); break;
+        case BATCH_NORMALIZE: batch_normalize(b, c); break;
+        case BATCH_DERIVE:    batch_derive(b, c); break;
+        case BATCH_WRITE:     batch_write(b, c); break;
+        }
+        b->busy[s->id] += posix_now() - t;
+
+        // the chunk belongs to the next stage after q_push()
+        eof = c->eof;
+        q_push(s->out, c);
+    } while (!eof);
+
+    return 0;
+}
+
+/*------------------------------------------------------------------*\
+\*------------------------------------------------------------------*/
+
+long batch_pipeline(struct BATCH* b) {
+
+    struct PIPELINE p;
+    pthread_t thread[BATCH_STAGES];
+    unsigned long long start = posix_now();
+    int i;
+
+    if (b->lock) {
+        if (lock_memory(&p, sizeof(p)) != 0) {
+            return osexit(4, "error: can't lock memory");
+        }
+    }
+    byte_zero(&p, sizeof(p));
+
+    for (i = 0; i < BATCH_STAGES; i++) {
+        pthread_mutex_init(&p.q[i].lock, 0);
+        pthread_cond_init(&p.q[i].wake, 0);
+        p.stage[i].id = i;
+        p.stage[i].b = b;
+        p.stage[i].in = &p.q[i];
+        p.stage[i].out = &p.q[(i + 1) % BATCH_STAGES];
+    }
+
+    // the writer runs on this thread. the chunks go to parse only when
+    // all threads are there: until then they wait on empty queues and
+    // a failure does not leave any of them in the middle of a stage.
+    for (i = 0; i < BATCH_WRITE; i++) {
+        if (pthread_create(&thread[i], 0, stage_run, &p.stage[i]) != 0) {
+            byte_zero(&p, sizeof(p));
+            if (b->lock) {
+                unlock_memory(&p, sizeof(p));
+            }
+            byte_zero(b, sizeof(*b));
+            return osexit(4, "error: can't create thread");
+        }
+    }
+    for (i = 0; i < PIPELINE_CHUNKS; i++) {
+        q_push(&p.q[BATCH_PARSE], &p.chunk[i]);
+    }
+    stage_run(&p.stage[BATCH_WRITE]);
+    for (i = 0; i < BATCH_WRITE; i++) {
+        pthread_join(thread[i], 0);
+    }
+
+    batch_flush(b);
+
+    for (i = 0; i < BATCH_STAGES; i++) {
+        pthread_mutex_destroy(&p.q[i].lock);
+        pthread_cond_destroy(&p.q[i].wake);
+    }
+    byte_zero(&p, sizeof(p));
+    if (b->lock) {
+        unlock_memory(&p, sizeof(p));
+    }
+
+    if (b->stats && !b->worker) {
+        batch_stats(b, posix_now() - start);
+    }
+    return (long)b->derived;
+}
+
+#else
+
+long batch_pipeline(struct BATCH* b) {
+    posix_write(2, "warning: built without threads, no -pipeline\n", 45);
+    return -1;
+}
+
+#endif
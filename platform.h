@@ -15,14 +15,92 @@
 
 extern int osexit(int code, const char* msg);
 
+extern int posix_open(const char* path); // read-only
+extern int posix_close(int fd);
 extern int posix_write(int fd, const void* buf, size_t n);
 extern int posix_read(int fd, void* buf, size_t n);
 extern int posix_fsync(int fd);
+extern int posix_seek(int fd, unsigned long long off); // -1 on pipes, O_APPEND
 extern int posix_isatty(int fd);
+// creates (or empties) 'path' for writing, mode 0600
+extern int posix_create(const char* path);
+extern int posix_rename(const char* from, const char* to);
+// cuts the file 'fd' to 'len' bytes and puts the offset there. -1 if
+// it is shorter than that or not a file.
+extern int posix_truncate(int fd, unsigned long long len);
+// waits up to 'us' microseconds for 'fd' to become readable. 1 if it
+// is (or it can't tell), 0 on timeout.
+extern int posix_wait_read(int fd, unsigned long us);
+
+// a monotonic clock, in nanoseconds
+extern unsigned long long posix_now(void);
 
 extern int tty_echo(int fd, int on);
 extern int discard_fd(int fd);
 
+// keeps a secret in the kernel keyring of the session. only
+// available on linux, everywhere else these return -1.
+extern int keyring_store(const char* name, const void* buf, size_t n, unsigned int timeout);
+extern int keyring_load(const char* name, void* buf, size_t n);
+extern int keyring_forget(const char* name);
+
+// hardware counters of the calling thread, user space only. linux
+// only, -1 everywhere else or if the kernel does not allow it (see
+// /proc/sys/kernel/perf_event_paranoid) or there is no pmu (vms).
+enum {
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTERS,
+};
+extern int perf_open(int fd[PERF_COUNTERS]);
+extern int perf_read(const int fd[PERF_COUNTERS], unsigned long long v[PERF_COUNTERS]);
+extern void perf_close(int fd[PERF_COUNTERS]);
+
+// maps the whole file 'path' read-only into memory. returns 0 on
+// errors. an empty file gives a valid pointer and *len == 0.
+extern const unsigned char* map_file(const char* path, size_t* len);
+extern void unmap_file(const unsigned char* p, size_t len);
+
+// the topology of numa machines, linux only. numa_cpus() puts the
+// cpus of 'node' (at most 'max') into 'cpu' and returns their
+// number, 0 if there is no such node. pin_cpu() binds the calling
+// process to 'cpu'. bind_node() asks for the pages of [p, p+len) on
+// 'node', it has to come before they are touched. -1 on errors and
+// everywhere else.
+extern int numa_cpus(int node, int* cpu, int max);
+extern int pin_cpu(int cpu);
+extern int bind_node(void* p, size_t len, int node);
+
+// reads and writes on one io_uring (linux, built with CSGP_URING).
+// aio_open() registers the 'n' buffers buf[i] of 'len' bytes each,
+// the ops name them by index, one op per buffer at a time. aio_read()
+// and aio_write() only queue an op at the current offset of 'fd', the
+// next aio_submit() or aio_wait() hands all queued ops to the kernel
+// in one syscall. aio_wait() returns the result of the op on 'buf':
+// the bytes, -1 on errors. aio_open() returns -1 if there is no
+// io_uring, the callers stay with posix_read() and posix_write().
+enum {
+    AIO_BUFS = 4,
+};
+extern int  aio_open(unsigned char* buf[], size_t len, int n);
+extern void aio_read(int fd, int buf, size_t n);
+extern void aio_write(int fd, int buf, size_t n);
+extern int  aio_submit(void);
+extern int  aio_wait(int buf);
+extern unsigned long aio_syscalls(void);
+extern void aio_close(void);
+
+// fork(), -1 where there is none. posix_wait() returns the exit
+// code of 'pid', -1 if it did not exit normally.
+extern int posix_fork(void);
+extern int posix_wait(int pid);
+
+// anonymous memory which is shared with the children forked after
+// it was mapped. it is not part of core dumps. returns 0 on errors.
+extern void* map_shared(size_t len);
+extern void unmap_shared(void* p, size_t len);
+
 extern int lock_memory(void* addr, size_t size);
 extern int unlock_memory(void* addr, size_t size);
 
@@ -13,6 +13,16 @@
 #define WIN32LEAN_AND_MEAN
 #include <windows.h>
 #include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+int posix_open(const char* path) {
+    return _open(path, _O_RDONLY | _O_BINARY);
+}
+
+int posix_close(int fd) {
+    return _close(fd);
+}
 
 int posix_write(int fd, const void* buf, size_t n) {
     return _write(fd, buf, n);
@@ -31,10 +41,41 @@ int posix_fsync(int fd) {
     return 0;
 }
 
+int posix_seek(int fd, unsigned long long off) {
+    return _lseeki64(fd, (__int64)off, SEEK_SET) == -1 ? -1 : 0;
+}
+
 int posix_isatty(int fd) {
     return _isatty(fd);
 }
 
+int posix_create(const char* path) {
+    return _open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+
+int posix_rename(const char* from, const char* to) {
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) ? 0 : -1;
+}
+
+int posix_truncate(int fd, unsigned long long len) {
+    if (_filelengthi64(fd) < (__int64)len || _chsize_s(fd, (__int64)len) != 0) {
+        return -1;
+    }
+    return _lseeki64(fd, (__int64)len, SEEK_SET) == -1 ? -1 : 0;
+}
+
+int posix_wait_read(int fd, unsigned long us) {
+    return 1; // no select() on pipes, the read blocks as before
+}
+
+unsigned long long posix_now(void) {
+    LARGE_INTEGER f, c;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&c);
+    return (unsigned long long)((c.QuadPart / f.QuadPart) * 1000000000ULL +
+        ((c.QuadPart % f.QuadPart) * 1000000000ULL) / f.QuadPart);
+}
+
 int discard_fd(int fd) {
     HANDLE h = (HANDLE)_get_osfhandle(fd);
     return (int)FlushConsoleInputBuffer(h);
@@ -54,6 +95,119 @@ int tty_echo(int fd, int on) {
     return 0;
 }
 
+int keyring_store(const char* name, const void* buf, size_t n, unsigned int timeout) {
+    return -1;
+}
+
+int keyring_load(const char* name, void* buf, size_t n) {
+    return -1;
+}
+
+int keyring_forget(const char* name) {
+    return -1;
+}
+
+const unsigned char* map_file(const char* path, size_t* len) {
+
+    static const unsigned char empty[1] = { 0 };
+    HANDLE f, m;
+    LARGE_INTEGER size;
+    void* p;
+
+    f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+        FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (f == INVALID_HANDLE_VALUE) {
+        return 0;
+    }
+    if (!GetFileSizeEx(f, &size)) {
+        CloseHandle(f);
+        return 0;
+    }
+    *len = (size_t)size.QuadPart;
+    if (*len == 0) {
+        CloseHandle(f);
+        return empty;
+    }
+    m = CreateFileMappingA(f, 0, PAGE_READONLY, 0, 0, 0);
+    CloseHandle(f);
+    if (m == 0) {
+        return 0;
+    }
+    p = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(m);
+    return (const unsigned char*)p;
+}
+
+void unmap_file(const unsigned char* p, size_t len) {
+    if (len > 0) {
+        UnmapViewOfFile(p);
+    }
+}
+
+int perf_open(int fd[PERF_COUNTERS]) {
+    return -1;
+}
+
+int perf_read(const int fd[PERF_COUNTERS], unsigned long long v[PERF_COUNTERS]) {
+    return -1;
+}
+
+void perf_close(int fd[PERF_COUNTERS]) {
+}
+
+int numa_cpus(int node, int* cpu, int max) {
+    return 0;
+}
+
+int pin_cpu(int cpu) {
+    return -1;
+}
+
+int bind_node(void* p, size_t len, int node) {
+    return -1;
+}
+
+int aio_open(unsigned char* buf[], size_t len, int n) {
+    return -1;
+}
+
+void aio_read(int fd, int buf, size_t n) {
+}
+
+void aio_write(int fd, int buf, size_t n) {
+}
+
+int aio_submit(void) {
+    return -1;
+}
+
+int aio_wait(int buf) {
+    return -1;
+}
+
+unsigned long aio_syscalls(void) {
+    return 0;
+}
+
+void aio_close(void) {
+}
+
+int posix_fork(void) {
+    return -1;
+}
+
+int posix_wait(int pid) {
+    return -1;
+}
+
+void* map_shared(size_t len) {
+    return VirtualAlloc(0, len, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+}
+
+void unmap_shared(void* p, size_t len) {
+    VirtualFree(p, 0, MEM_RELEASE);
+}
+
 int lock_memory(void* addr, unsigned int size) {
     return !VirtualLock(addr, size);
 }
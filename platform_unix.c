@@ -8,11 +8,49 @@
 \*------------------------------------------------------------------*/
 
 #include "platform.h"
+#include "djb/byte.h"
+#include "djb/fmt.h"
+#include "djb/scan.h"
+#include "djb/str.h"
 
+#include <stdio.h> // rename()
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/mman.h> // mlock() etc; FreeBSD/MacOSX needs it
 #include <termios.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/select.h>
+#include <sys/wait.h>
 
+#if defined(__linux__)
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <string.h> // memset()
+// from <linux/keyctl.h>, which is not always around
+#define KEY_SPEC_SESSION_KEYRING -3
+#define KEYCTL_REVOKE             3
+#define KEYCTL_SETPERM            5
+#define KEYCTL_SEARCH            10
+#define KEYCTL_READ              11
+#define KEYCTL_SET_TIMEOUT       15
+#define KEY_POS_ALL      0x3f000000 // possessor only
+// from <numaif.h>, which comes with libnuma
+#define MPOL_PREFERRED            1
+#endif
+
+#if defined(__linux__) && defined(CSGP_URING)
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#include <errno.h>
+#endif
+
+int posix_open(const char* path) {
+    return open(path, O_RDONLY);
+}
+int posix_close(int fd) {
+    return close(fd);
+}
 int posix_write(int fd, const void* buf, size_t n) {
     return write(fd, buf, n);
 }
@@ -22,21 +60,70 @@ int posix_read(int fd, void* buf, size_t n) {
 int posix_fsync(int fd) {
     return fsync(fd);
 }
+int posix_seek(int fd, unsigned long long off) {
+    int fl = fcntl(fd, F_GETFL);
+    if (fl == -1 || (fl & O_APPEND)) { // writes would not go to 'off'
+        return -1;
+    }
+    return lseek(fd, (off_t)off, SEEK_SET) == (off_t)-1 ? -1 : 0;
+}
 int posix_isatty(int fd) {
     return isatty(fd);
 }
+int posix_create(const char* path) {
+    return open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+}
+int posix_rename(const char* from, const char* to) {
+    return rename(from, to);
+}
+int posix_truncate(int fd, unsigned long long len) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (unsigned long long)st.st_size < len) {
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)len) != 0) {
+        return -1;
+    }
+    return lseek(fd, (off_t)len, SEEK_SET) == (off_t)-1 ? -1 : 0;
+}
+int posix_wait_read(int fd, unsigned long us) {
+    fd_set set;
+    struct timeval tv;
+    FD_ZERO(&set);
+    FD_SET(fd, &set);
+    tv.tv_sec = us / 1000000;
+    tv.tv_usec = us % 1000000;
+    return select(fd + 1, &set, 0, 0, &tv) == 0 ? 0 : 1;
+}
+
+unsigned long long posix_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
 
 int discard_fd(int fd) {
     return tcflush(fd, TCIOFLUSH);
 }
 
+// the state before the echo went off, tty_echo(fd, 1) puts it back
+// without asking the terminal again
+static struct termios tty_saved;
+static int tty_off = 0;
+
 int tty_echo(int fd, int on) {
 
     struct termios tty;
-    tcgetattr(fd, &tty);
     if (!on) {
+        tcgetattr(fd, &tty_saved);
+        tty = tty_saved;
         tty.c_lflag &= ~ECHO;
+        tty_off = 1;
+    } else if (tty_off) {
+        tty = tty_saved;
+        tty_off = 0;
     } else {
+        tcgetattr(fd, &tty);
         tty.c_lflag |= ECHO;
     }
 
@@ -46,6 +133,498 @@ int tty_echo(int fd, int on) {
     return 1;
 }
 
+#if defined(__linux__)
+
+int keyring_store(const char* name, const void* buf, size_t n, unsigned int timeout) {
+
+    long id = syscall(SYS_add_key, "user", name, buf, n, KEY_SPEC_SESSION_KEYRING);
+    if (id == -1) {
+        return -1;
+    }
+    if (syscall(SYS_keyctl, KEYCTL_SETPERM, id, KEY_POS_ALL) != 0 ||
+        syscall(SYS_keyctl, KEYCTL_SET_TIMEOUT, id, timeout) != 0) {
+        syscall(SYS_keyctl, KEYCTL_REVOKE, id);
+        return -1;
+    }
+    return 0;
+}
+
+int keyring_load(const char* name, void* buf, size_t n) {
+
+    long l;
+    long id = syscall(SYS_keyctl, KEYCTL_SEARCH, KEY_SPEC_SESSION_KEYRING, "user", name, 0);
+    if (id == -1) {
+        return -1;
+    }
+    l = syscall(SYS_keyctl, KEYCTL_READ, id, buf, n);
+    if (l < 0 || (size_t)l > n) { // a payload larger than 'n' is not ours
+        return -1;
+    }
+    return (int)l;
+}
+
+int keyring_forget(const char* name) {
+
+    long id = syscall(SYS_keyctl, KEYCTL_SEARCH, KEY_SPEC_SESSION_KEYRING, "user", name, 0);
+    if (id == -1) {
+        return -1;
+    }
+    return (int)syscall(SYS_keyctl, KEYCTL_REVOKE, id);
+}
+
+int perf_open(int fd[PERF_COUNTERS]) {
+
+    static const unsigned long long config[PERF_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_BRANCH_MISSES,
+    };
+    struct perf_event_attr attr;
+    int i;
+
+    for (i = 0; i < PERF_COUNTERS; i++) {
+        fd[i] = -1;
+    }
+    for (i = 0; i < PERF_COUNTERS; i++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = config[i];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd[i] == -1) {
+            perf_close(fd);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int perf_read(const int fd[PERF_COUNTERS], unsigned long long v[PERF_COUNTERS]) {
+
+    int i;
+
+    for (i = 0; i < PERF_COUNTERS; i++) {
+        if (read(fd[i], &v[i], sizeof(v[i])) != sizeof(v[i])) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void perf_close(int fd[PERF_COUNTERS]) {
+
+    int i;
+
+    for (i = 0; i < PERF_COUNTERS; i++) {
+        if (fd[i] != -1) {
+            close(fd[i]);
+        }
+        fd[i] = -1;
+    }
+}
+
+// "0-3,8-11\n" -> 0 1 2 3 8 9 10 11
+int numa_cpus(int node, int* cpu, int max) {
+
+    char path[64] = "/sys/devices/system/node/node";
+    char buf[1024];
+    size_t i = str_len(path);
+    int fd, len, n = 0;
+    unsigned long a, b;
+
+    if (node < 0) {
+        return 0;
+    }
+    i += fmt_ulong(path + i, (unsigned long)node);
+    byte_copy(path + i, 9, "/cpulist");
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return 0;
+    }
+    len = (int)read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (len <= 0) {
+        return 0;
+    }
+    buf[len] = 0;
+
+    for (i = 0; buf[i] >= '0' && buf[i] <= '9'; ) {
+        i += scan_ulong(buf + i, &a);
+        b = a;
+        if (buf[i] == '-') {
+            i++;
+            i += scan_ulong(buf + i, &b);
+        }
+        for (; a <= b && n < max; a++) {
+            cpu[n++] = (int)a;
+        }
+        if (buf[i] == ',') {
+            i++;
+        }
+    }
+    return n;
+}
+
+int pin_cpu(int cpu) {
+
+    unsigned long mask[16]; // 1024 cpus, like cpu_set_t
+    size_t bits = sizeof(mask[0]) * 8;
+
+    if (cpu < 0 || (size_t)cpu >= sizeof(mask) * 8) {
+        return -1;
+    }
+    memset(mask, 0, sizeof(mask));
+    mask[cpu / bits] = 1UL << (cpu % bits);
+    return (int)syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask);
+}
+
+// the pages are placed on 'node' when they are touched (or locked)
+// first, they go elsewhere only if the node is out of memory
+int bind_node(void* p, size_t len, int node) {
+
+    unsigned long mask;
+
+    if (node < 0 || node >= (int)(sizeof(mask) * 8)) {
+        return -1;
+    }
+    mask = 1UL << node;
+    return (int)syscall(SYS_mbind, p, len, MPOL_PREFERRED, &mask, sizeof(mask) * 8, 0);
+}
+
+#else
+
+int keyring_store(const char* name, const void* buf, size_t n, unsigned int timeout) {
+    return -1;
+}
+int keyring_load(const char* name, void* buf, size_t n) {
+    return -1;
+}
+int keyring_forget(const char* name) {
+    return -1;
+}
+
+int perf_open(int fd[PERF_COUNTERS]) {
+    return -1;
+}
+int perf_read(const int fd[PERF_COUNTERS], unsigned long long v[PERF_COUNTERS]) {
+    return -1;
+}
+void perf_close(int fd[PERF_COUNTERS]) {
+}
+
+int numa_cpus(int node, int* cpu, int max) {
+    return 0;
+}
+int pin_cpu(int cpu) {
+    return -1;
+}
+int bind_node(void* p, size_t len, int node) {
+    return -1;
+}
+
+#endif
+
+#if defined(__linux__) && defined(CSGP_URING)
+
+// no liburing: the rings are mapped by hand, see io_uring_setup(2)
+enum {
+    AIO_ENTRIES = 8,
+};
+
+static struct {
+    int                     fd;
+    int                     fixed;  // the buffers are registered
+    unsigned char*          buf[AIO_BUFS];
+    void*                   sq_ring;
+    size_t                  sq_len;
+    void*                   cq_ring;
+    size_t                  cq_len;
+    struct io_uring_sqe*    sqe;
+    size_t                  sqe_len;
+    unsigned*               sq_tail;
+    unsigned*               sq_mask;
+    unsigned*               sq_array;
+    unsigned*               cq_head;
+    unsigned*               cq_tail;
+    unsigned*               cq_mask;
+    struct io_uring_cqe*    cqe;
+    unsigned                queued; // not handed to the kernel yet
+    int                     busy[AIO_BUFS];
+    int                     res[AIO_BUFS];
+    unsigned long           calls;
+} ring = { -1 };
+
+int aio_open(unsigned char* buf[], size_t len, int n) {
+
+    struct io_uring_params p;
+    struct iovec iov[AIO_BUFS];
+    unsigned char* sq;
+    unsigned char* cq;
+    int i;
+
+    if (ring.fd != -1 || n > AIO_BUFS) {
+        return -1;
+    }
+    memset(&p, 0, sizeof(p));
+    ring.fd = (int)syscall(__NR_io_uring_setup, AIO_ENTRIES, &p);
+    if (ring.fd < 0) {
+        ring.fd = -1;
+        return -1;
+    }
+    // the ops use the offset of the fd, like read() and write() (5.6)
+    if (!(p.features & IORING_FEAT_RW_CUR_POS)) {
+        aio_close();
+        return -1;
+    }
+
+    ring.sq_len = p.sq_off.array + (p.sq_entries * sizeof(unsigned));
+    ring.cq_len = p.cq_off.cqes + (p.cq_entries * sizeof(struct io_uring_cqe));
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring.cq_len > ring.sq_len) {
+            ring.sq_len = ring.cq_len;
+        }
+        ring.cq_len = 0;
+    }
+    ring.sq_ring = mmap(0, ring.sq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+        ring.fd, IORING_OFF_SQ_RING);
+    if (ring.sq_ring == MAP_FAILED) {
+        ring.sq_ring = 0;
+        aio_close();
+        return -1;
+    }
+    ring.cq_ring = ring.sq_ring;
+    if (ring.cq_len > 0) {
+        ring.cq_ring = mmap(0, ring.cq_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            ring.fd, IORING_OFF_CQ_RING);
+        if (ring.cq_ring == MAP_FAILED) {
+            ring.cq_ring = 0;
+            aio_close();
+            return -1;
+        }
+    }
+    ring.sqe_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring.sqe = (struct io_uring_sqe*)mmap(0, ring.sqe_len, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+    if (ring.sqe == MAP_FAILED) {
+        ring.sqe = 0;
+        aio_close();
+        return -1;
+    }
+
+    sq = (unsigned char*)ring.sq_ring;
+    cq = (unsigned char*)ring.cq_ring;
+    ring.sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    ring.sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    ring.sq_array = (unsigned*)(sq + p.sq_off.array);
+    ring.cq_head = (unsigned*)(cq + p.cq_off.head);
+    ring.cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    ring.cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    ring.cqe = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+    // registered buffers skip the page walk of every op. they count
+    // against RLIMIT_MEMLOCK, without them the ops take plain buffers.
+    for (i = 0; i < n; i++) {
+        ring.buf[i] = buf[i];
+        iov[i].iov_base = buf[i];
+        iov[i].iov_len = len;
+    }
+    ring.fixed = (syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_BUFFERS, iov, n) == 0);
+    return 0;
+}
+
+static void aio_queue(int op, int fd, int buf, size_t n) {
+
+    unsigned tail = *ring.sq_tail;
+    unsigned i = tail & *ring.sq_mask;
+    struct io_uring_sqe* e = &ring.sqe[i];
+
+    memset(e, 0, sizeof(*e));
+    e->opcode = (unsigned char)op;
+    e->fd = fd;
+    e->off = (unsigned long long)-1; // the offset of the fd
+    e->addr = (unsigned long long)(unsigned long)ring.buf[buf];
+    e->len = (unsigned)n;
+    e->buf_index = (unsigned short)buf;
+    e->user_data = (unsigned long long)buf;
+    ring.sq_array[i] = i;
+    __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+    ring.queued++;
+    ring.busy[buf] = 1;
+}
+
+void aio_read(int fd, int buf, size_t n) {
+    aio_queue(ring.fixed ? IORING_OP_READ_FIXED : IORING_OP_READ, fd, buf, n);
+}
+
+void aio_write(int fd, int buf, size_t n) {
+    aio_queue(ring.fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE, fd, buf, n);
+}
+
+static void aio_reap(void) {
+
+    unsigned head = *ring.cq_head;
+    unsigned tail = __atomic_load_n(ring.cq_tail, __ATOMIC_ACQUIRE);
+    struct io_uring_cqe* c;
+
+    for (; head != tail; head++) {
+        c = &ring.cqe[head & *ring.cq_mask];
+        if (c->user_data < AIO_BUFS) {
+            ring.res[c->user_data] = c->res;
+            ring.busy[c->user_data] = 0;
+        }
+    }
+    __atomic_store_n(ring.cq_head, head, __ATOMIC_RELEASE);
+}
+
+static int aio_enter(unsigned wait) {
+
+    long rc;
+
+    do {
+        ring.calls++;
+        rc = syscall(__NR_io_uring_enter, ring.fd, ring.queued, wait,
+            wait ? IORING_ENTER_GETEVENTS : 0, 0, 0);
+    } while (rc < 0 && errno == EINTR);
+    if (rc < 0) {
+        return -1;
+    }
+    ring.queued -= (unsigned)rc;
+    return 0;
+}
+
+int aio_submit(void) {
+    return ring.queued > 0 ? aio_enter(0) : 0;
+}
+
+int aio_wait(int buf) {
+
+    aio_reap();
+    while (ring.busy[buf]) {
+        if (aio_enter(1) != 0) {
+            return -1;
+        }
+        aio_reap();
+    }
+    return ring.res[buf] < 0 ? -1 : ring.res[buf];
+}
+
+unsigned long aio_syscalls(void) {
+    return ring.calls;
+}
+
+void aio_close(void) {
+
+    if (ring.sqe) {
+        munmap(ring.sqe, ring.sqe_len);
+    }
+    if (ring.cq_ring && ring.cq_ring != ring.sq_ring) {
+        munmap(ring.cq_ring, ring.cq_len);
+    }
+    if (ring.sq_ring) {
+        munmap(ring.sq_ring, ring.sq_len);
+    }
+    if (ring.fd != -1) {
+        close(ring.fd);
+    }
+    memset(&ring, 0, sizeof(ring));
+    ring.fd = -1;
+}
+
+#else
+
+int aio_open(unsigned char* buf[], size_t len, int n) {
+    return -1;
+}
+void aio_read(int fd, int buf, size_t n) {
+}
+void aio_write(int fd, int buf, size_t n) {
+}
+int aio_submit(void) {
+    return -1;
+}
+int aio_wait(int buf) {
+    return -1;
+}
+unsigned long aio_syscalls(void) {
+    return 0;
+}
+void aio_close(void) {
+}
+
+#endif
+
+const unsigned char* map_file(const char* path, size_t* len) {
+
+    static const unsigned char empty[1] = { 0 };
+    struct stat st;
+    void* p;
+    int fd = open(path, O_RDONLY);
+
+    if (fd == -1) {
+        return 0;
+    }
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return 0;
+    }
+    *len = (size_t)st.st_size;
+    if (*len == 0) {
+        close(fd);
+        return empty;
+    }
+    p = mmap(0, *len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return 0;
+    }
+#if defined(MADV_SEQUENTIAL)
+    madvise(p, *len, MADV_SEQUENTIAL);
+#endif
+    return (const unsigned char*)p;
+}
+
+void unmap_file(const unsigned char* p, size_t len) {
+    if (len > 0) {
+        munmap((void*)p, len);
+    }
+}
+
+int posix_fork(void) {
+    return fork();
+}
+
+int posix_wait(int pid) {
+    int status;
+
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+}
+
+// MADV_DONTFORK would hide the memory from the children, which is
+// the opposite of what it is for
+void* map_shared(size_t len) {
+
+    void* p = mmap(0, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (p == MAP_FAILED) {
+        return 0;
+    }
+#if defined(MADV_DONTDUMP)
+    madvise(p, len, MADV_DONTDUMP);
+#endif
+    return p;
+}
+
+void unmap_shared(void* p, size_t len) {
+    munmap(p, len);
+}
+
 int lock_memory(void* addr, size_t size) {
     return mlock(addr, (unsigned int)size);
 }
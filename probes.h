@@ -0,0 +1,46 @@
+#ifndef _PROBES_H_
+#define _PROBES_H_
+
+/*------------------------------------------------------------------*\
+
+       file: probes.h
+      about: static probes (USDT) for bpftrace, systemtap and co
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+   the probes of the provider 'csgp':
+
+     derive__start(domain_len, lengths)  one domain, see SGP_LENGTH()
+     derive__end(extra_rounds, lengths)  rounds after MAX_ROUNDS
+     io__wait__start(fd)                 read_pw(), the batch input
+     io__wait__end(fd, bytes)            and output
+     chunk__start(records)               batch_derive()
+     chunk__end(records)
+
+   the probes get sizes and counts only, never a byte of a master,
+   a domain or a password.
+
+   with -DCSGP_SDT (cmake sets it when <sys/sdt.h> is around) every
+   probe is a single nop plus a note in the binary:
+
+     $> bpftrace -e 'usdt:./csgp:csgp:derive__end { @[arg0] = count(); }'
+
+   without it the probes are not there at all.
+
+\*------------------------------------------------------------------*/
+
+#if defined(CSGP_SDT)
+
+#include <sys/sdt.h>
+
+#define PROBE1(name, a)     DTRACE_PROBE1(csgp, name, a)
+#define PROBE2(name, a, b)  DTRACE_PROBE2(csgp, name, a, b)
+
+#else
+
+#define PROBE1(name, a)     do { } while (0)
+#define PROBE2(name, a, b)  do { } while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,400 @@
+/*------------------------------------------------------------------*\
+
+       file: procs.c
+      about: runs the batch engine in several worker processes
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+   the parent makes one pass over the mapped input (b->in.mem):
+   it counts the masters, splits the input at chunk boundaries into
+   b->procs parts of about the same size and sums up the size of
+   the output of every part. nothing is derived in that pass. then
+   it maps an area for as many masters as there are and reads them
+   from the master-fd.
+
+   then every part gets its own worker process and its own slice of
+   one shared output region:
+
+     input:   [ part 0 ][ part 1 ][ part 2 ]   (the mapped file)
+     output:  [ slice 0  ][ slice 1  ][ slice 2 ]  (shared, locked)
+
+   a worker starts with the state of the parser at the start of its
+   part (line, masters) and runs the serial engine into its slice.
+   the parent waits for all workers and writes the slices in order,
+   the output is the same as without -procs.
+
+   the masters and the output are locked (if b->lock) and zeroed
+   before they are unmapped.
+
+   on numa machines (more than one node in /sys/devices/system/node)
+   the parts go to the nodes in order, part k to node k*nodes/parts,
+   and every worker is pinned to a core of its node. each node has
+   its own arena with a copy of the masters and the slices of its
+   parts, placed on the node (bind_node()) before it is locked. a
+   worker locks its own copy of 'b' (the chunk, the lanes, the
+   passwords) after it is pinned, so these pages are copied to its
+   node as well. the arenas are written in node order, which is
+   still the order of the input:
+
+     node 0:  [ masters ][ slice 0 ][ slice 1 ]
+     node 1:  [ masters ][ slice 2 ][ slice 3 ]
+
+\*------------------------------------------------------------------*/
+
+#include "batch.h"
+#include "platform.h"
+
+#include "djb/byte.h"
+
+enum {
+    PROCS_MAX     = 64,
+    PROCS_NODES   = 8,   // numa nodes
+    PROCS_CPUS    = 256, // cpus per node
+};
+
+struct PART {
+    size_t              in_off;   // the part is b->in.mem[in_off, in_end)
+    size_t              in_end;
+    size_t              out_off;  // the slice is out[out_off, +out_cap)
+    size_t              out_cap;
+    unsigned long       line;     // the state of the parser at in_off
+    unsigned long       tenants;
+    int                 has_master;
+    int                 next_master;
+    int                 node;     // the arena of the part
+    int                 cpu;      // pin the worker here, -1: don't
+
+    // written by the worker
+    size_t              out_len;
+    unsigned long       derived;
+    unsigned long       reused;
+    unsigned long       deduped;
+    unsigned long long  records;
+    unsigned long long  busy[BATCH_STAGES];
+    unsigned long long  lane_steps;
+    unsigned long long  lane_used;
+};
+
+// lives in shared memory
+struct PROCS {
+    struct PART         part[PROCS_MAX];
+};
+
+// the numa nodes with cpus and their arenas
+struct NODES {
+    int                 n;
+    int                 id[PROCS_NODES];
+    int                 cpus[PROCS_NODES];
+    int                 cpu[PROCS_NODES][PROCS_CPUS];
+    unsigned char*      arena[PROCS_NODES]; // masters, then the slices
+    size_t              size[PROCS_NODES];
+};
+
+/*------------------------------------------------------------------*\
+\*------------------------------------------------------------------*/
+
+static size_t in_offset(struct BATCH_IO* io) {
+    return io->mem_pos - (io->len - io->pos);
+}
+
+static void part_start(struct BATCH* b, struct PART* p) {
+    p->in_off = in_offset(&b->in);
+    p->line = b->line;
+    p->tenants = b->tenants;
+    p->has_master = b->has_master;
+    p->next_master = b->next_master;
+}
+
+// splits the input into parts. returns the number of parts.
+static int split(struct BATCH* b, struct PROCS* s) {
+
+    struct BATCH_CHUNK* c = &b->chunk;
+    size_t total = b->in.mem_len;
+    size_t i;
+    int n = 0;
+
+    part_start(b, &s->part[0]);
+    do {
+        if (n + 1 < b->procs && in_offset(&b->in) >= (total / b->procs) * (n + 1)) {
+            s->part[n].in_end = in_offset(&b->in);
+            n++;
+            part_start(b, &s->part[n]);
+        }
+        batch_fill(b, c);
+        for (i = 0; i < c->n; i++) {
+            s->part[n].out_cap += batch_out_size(b, &c->rec[i]);
+        }
+    } while (!c->eof);
+    s->part[n].in_end = total;
+
+    byte_zero(c, sizeof(*c));
+    return n + 1;
+}
+
+static int write_all(int fd, const unsigned char* p, size_t n) {
+
+    size_t i;
+    int rc;
+
+    for (i = 0; i < n; i += rc) {
+        rc = posix_write(fd, p + i, n - i);
+        if (rc <= 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// reads the topology. a machine without numa (or without sysfs)
+// is one node without pinning.
+static void topology(struct NODES* t) {
+
+    int node, c;
+
+    byte_zero(t, sizeof(*t));
+    for (node = 0; node < PROCS_NODES; node++) {
+        c = numa_cpus(node, t->cpu[t->n], PROCS_CPUS);
+        if (c > 0) {
+            t->id[t->n] = node;
+            t->cpus[t->n] = c;
+            t->n++;
+        }
+    }
+    if (t->n <= 1) {
+        t->n = 1;
+        t->id[0] = -1;
+    }
+}
+
+// part k goes to node k*nodes/n, the parts of a node to its cpus
+// one after another
+static void place(struct NODES* t, struct PART* part, int n) {
+
+    int k, first = 0;
+
+    for (k = 0; k < n; k++) {
+        part[k].node = (k * t->n) / n;
+        if (k == 0 || part[k].node != part[k-1].node) {
+            first = k;
+        }
+        part[k].cpu = -1;
+        if (t->n > 1) {
+            part[k].cpu = t->cpu[part[k].node][(k - first) % t->cpus[part[k].node]];
+        }
+    }
+}
+
+// runs in the child: part 'p' into its slice of 'out'
+static void worker(struct BATCH* b, struct PART* p, md5Context* masters, unsigned char* out) {
+
+    // first the core, then the locks: they copy 'b' to this node
+    if (p->cpu >= 0) {
+        pin_cpu(p->cpu);
+    }
+    if (b->lock) {
+        // locks are not inherited
+        if (lock_memory(b, sizeof(*b)) != 0) {
+            osexit(4, "error: can't lock memory");
+        }
+    }
+    // every worker has its own set, on its own node
+    if (b->dedup && dedup_open(b->dedup, b->dedup->cap, b->lock) != 0) {
+        osexit(4, "error: can't map memory for -dedup");
+    }
+
+    b->worker = 1;
+    b->masters = masters;
+    b->line = p->line;
+    b->tenants = p->tenants;
+    b->has_master = p->has_master;
+    b->next_master = p->next_master;
+    b->tag_of = 0; // the tag is the one of the parent's last master
+    if (b->has_master) {
+        byte_copy(&b->base, sizeof(b->base), &b->masters[b->tenants - 1]);
+    }
+
+    b->in.mem_pos = p->in_off;
+    b->in.mem_len = p->in_end;
+    b->in.pos = b->in.len = 0;
+    b->in.eof = 0;
+
+    byte_zero(b->out.buf, sizeof(b->out.buf));
+    b->out.len = 0;
+    b->out.mem = out + p->out_off;
+    b->out.mem_pos = 0;
+    b->out.mem_len = p->out_cap;
+
+    batch_run(b);
+
+    p->out_len = b->out.mem_pos;
+    p->derived = b->derived;
+    p->reused = b->reused;
+    p->deduped = b->deduped;
+    p->records = b->records;
+    byte_copy(p->busy, sizeof(p->busy), b->busy);
+    p->lane_steps = b->lanes.steps;
+    p->lane_used = b->lanes.used;
+
+    if (b->dedup) {
+        dedup_close(b->dedup);
+    }
+    byte_zero(b, sizeof(*b));
+    osexit(0, 0);
+}
+
+/*------------------------------------------------------------------*\
+\*------------------------------------------------------------------*/
+
+long batch_procs(struct BATCH* b) {
+
+    unsigned long long start = posix_now();
+    struct PROCS* s;
+    md5Context* masters = 0;
+    struct NODES t;
+    size_t masters_size;
+    size_t i;
+    const char* err = 0; // after the masters are read: to the cleanup
+    int pid[PROCS_MAX];
+    int n, k, failed = 0;
+
+    if (b->procs > PROCS_MAX) {
+        b->procs = PROCS_MAX;
+    }
+
+    s = (struct PROCS*)map_shared(sizeof(*s));
+    if (s == 0) {
+        return osexit(4, "error: can't map memory for -procs");
+    }
+    if (b->lock && lock_memory(s, sizeof(*s)) != 0) {
+        return osexit(4, "error: can't lock memory");
+    }
+    byte_zero(s, sizeof(*s));
+
+    b->counting = 1;
+    n = split(b, s);
+    b->counting = 0;
+
+    masters_size = b->tenants * sizeof(md5Context);
+    if (masters_size > 0) {
+        masters = (md5Context*)map_shared(masters_size);
+        if (masters == 0) {
+            return osexit(4, "error: can't map memory for -procs");
+        }
+        if (b->lock && lock_memory(masters, masters_size) != 0) {
+            return osexit(4, "error: can't lock memory");
+        }
+        b->masters = masters;
+        b->masters_cap = b->tenants;
+        batch_masters(b, b->tenants);
+    }
+
+    // the arenas: the masters, then the slices of the node's parts
+    topology(&t);
+    place(&t, s->part, n);
+    for (k = 0; k < n; k++) {
+        struct PART* p = &s->part[k];
+        if (t.size[p->node] == 0) {
+            t.size[p->node] = masters_size;
+        }
+        p->out_off = t.size[p->node];
+        t.size[p->node] += p->out_cap;
+    }
+    for (i = 0; !err && i < (size_t)t.n; i++) {
+        if (t.size[i] == 0) {
+            continue;
+        }
+        t.arena[i] = (unsigned char*)map_shared(t.size[i]);
+        if (t.arena[i] == 0) {
+            err = "error: can't map memory for -procs";
+        } else {
+            if (t.id[i] >= 0) {
+                bind_node(t.arena[i], t.size[i], t.id[i]);
+            }
+            if (b->lock && lock_memory(t.arena[i], t.size[i]) != 0) {
+                err = "error: can't lock memory";
+            } else {
+                byte_copy(t.arena[i], masters_size, masters);
+            }
+        }
+    }
+
+    for (k = 0; !err && k < n; k++) {
+        unsigned char* arena = t.arena[s->part[k].node];
+        // not into 's', the child would see its own 0 there
+        pid[k] = posix_fork();
+        if (pid[k] == 0) {
+            worker(b, &s->part[k], (md5Context*)arena, arena);
+        } else if (pid[k] == -1) {
+            failed = 1;
+            break;
+        }
+    }
+
+    for (k--; k >= 0; k--) {
+        if (posix_wait(pid[k]) != 0 || s->part[k].out_len != s->part[k].out_cap) {
+            failed = 1;
+        }
+    }
+
+    if (!err && !failed) {
+        // the header of -output=bin is still in b->out
+        failed = write_all(b->out.fd, b->out.buf, b->out.len);
+        b->out.len = 0;
+        for (i = 0; !failed && i < (size_t)t.n; i++) {
+            if (t.size[i] > masters_size) {
+                failed = write_all(b->out.fd, t.arena[i] + masters_size, t.size[i] - masters_size);
+            }
+        }
+        for (k = 0; k < n; k++) {
+            b->derived += s->part[k].derived;
+            b->reused += s->part[k].reused;
+            b->deduped += s->part[k].deduped;
+            b->records += s->part[k].records;
+            b->lanes.steps += s->part[k].lane_steps;
+            b->lanes.used += s->part[k].lane_used;
+            for (i = 0; i < BATCH_STAGES; i++) {
+                b->busy[i] += s->part[k].busy[i];
+            }
+        }
+    }
+
+    b->masters = 0;
+    b->masters_cap = 0;
+    if (masters) {
+        byte_zero(masters, masters_size);
+        if (b->lock) {
+            unlock_memory(masters, masters_size);
+        }
+        unmap_shared(masters, masters_size);
+    }
+    byte_zero(s, sizeof(*s));
+    if (b->lock) {
+        unlock_memory(s, sizeof(*s));
+    }
+    unmap_shared(s, sizeof(*s));
+    for (i = 0; i < (size_t)t.n; i++) {
+        if (t.arena[i]) {
+            byte_zero(t.arena[i], t.size[i]);
+            if (b->lock) {
+                unlock_memory(t.arena[i], t.size[i]);
+            }
+            unmap_shared(t.arena[i], t.size[i]);
+        }
+    }
+
+    if (err) {
+        byte_zero(b, sizeof(*b));
+        return osexit(4, err);
+    }
+    if (failed) {
+        byte_zero(b, sizeof(*b));
+        return osexit(5, "error: a -procs worker failed");
+    }
+
+    batch_flush(b);
+
+    if (b->stats) {
+        batch_stats(b, posix_now() - start);
+    }
+    return (long)b->derived;
+}
@@ -0,0 +1,551 @@
+/*------------------------------------------------------------------*\
+
+       file: sgp.c
+      about: the supergenpass algorithm
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+   SUPERGENPASS:
+
+     in_pw:domain
+      |
+      v
+     input -> md5Context.state     (16bytes)
+      ^            |
+      |            v
+      |       md5_final(raw, &ctx) (16bytes)
+      |            |
+      |            v
+      |       base64(out, raw)     (24bytes)
+      |            |
+      |            v
+      +------ valid_n()
+                   |
+                   v
+                  out
+   notes:
+
+   - the initial password is stored only once in the working
+     buffer. it get's overwritten in the first round already.
+   - for the whole process we allocate only 25 bytes: the amount
+     of ram needed to base64_encode(16 bytes) == 24 bytes PLUS
+     1 extra byte to detect, if the given master password is too
+     long (see read_pw()).
+   - the 16 bytes for the digest are stored inside the 24 byte buffer
+     (like this: [24......[16..............]] ). this works because
+     * the master-passwords ends directly as a md5-state in the first round
+     * the md5-state is copied over into the 16byte block
+     * the 16byte block gets base64-encoded. the b64-encoder chases the
+       currently processed byte from the 16byte block but never catches
+       up; except for the last round. in that round, any trace of the raw
+       md5-state got erased by the base64-version of it:
+
+           +--------+
+       [aaaa.......[111.........]]
+       [aaaabbbb...[111222......]]
+       [aaaabbbbccc[c11222333...]]
+
+     * the 24byte buffer is then transformed into a md5-state and
+       the whole process repeats.
+
+   - in addition we need one md5Context and bytes for the
+     domain which we get by argv[]
+   - all sensitive information gets overwritten as soon
+     as it is not needed anymore
+
+\*------------------------------------------------------------------*/
+
+#include "sgp.h"
+#include "platform.h"
+
+#include "probes.h"
+#include "djb/byte.h"
+
+static const char PROMPT[] = "password: ";
+
+const unsigned char B64_SGP_TABLE[BASE64_LUT_LEN] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+    "abcdefghijklmnopqrstuvwxyz"
+    "012345678998A";
+
+/*------------------------------------------------------------------*\
+\*------------------------------------------------------------------*/
+
+int supergenpass(struct SGP* sgp) {
+
+    sgp_prime(&(sgp->md5), sgp->pw, sgp->in_len);
+    return supergenpass_primed(sgp);
+}
+
+void sgp_prime(md5Context* ctx, const unsigned char* master, size_t len) {
+
+    md5_init(ctx);
+    md5_update(ctx, master, len);
+    md5_update(ctx, (unsigned char*)":", 1);
+}
+
+// one more round: pw -> md5 -> raw -> base64 -> pw
+static void round_md5(md5Context* ctx, unsigned char* pw, unsigned char* raw) {
+    md5_init(ctx);
+    md5_update(ctx, pw, B64_MD5_DIGEST_LENGTH);
+    md5_final(raw, ctx);
+    base64_encode(pw, raw, MD5_DIGEST_LENGTH, B64_SGP_TABLE);
+}
+
+// the initial round plus the other MAX_ROUNDS - 1. the part of the
+// chain which does not depend on the length of the password.
+static void chain_md5(struct SGP* sgp) {
+
+    md5Context* ctx = &(sgp->md5);
+    unsigned char* pw = &(sgp->pw[0]);
+    unsigned char* raw = &(sgp->pw[B64_MD5_DIGEST_LENGTH-MD5_DIGEST_LENGTH]);
+    int round;
+
+    // the initial round, 'master:' is already in ctx. up to two
+    // blocks (a domain of up to ~90 bytes) in one go.
+    if (md5_short(raw, ctx, sgp->domain, sgp->domain_len)) {
+        byte_zero(ctx, sizeof(*ctx));
+    } else {
+        md5_update(ctx, sgp->domain, sgp->domain_len);
+        md5_final(raw, ctx);
+    }
+    base64_encode(pw, raw, MD5_DIGEST_LENGTH, B64_SGP_TABLE);
+
+    for (round = 1; round < MAX_ROUNDS; round++) {
+        round_md5(ctx, pw, raw);
+    }
+}
+
+/*------------------------------------------------------------------*\
+   the kernels: one supergenpass_primed() per (method, length), made
+   by SGP_KERNEL(). the length is a constant in each of them: the
+   check of the candidate (SGP_VALID(), without branches) and the
+   wipe have a fixed size, the chain has MAX_ROUNDS rounds anyway. sgp_kernel() picks one from the table, once per password
+   in single mode, once per job on the lanes (see lanes_load()).
+
+   md5 is the only method so far. another one brings its own chain
+   and round and one more row of KERNELS.
+\*------------------------------------------------------------------*/
+
+#define SGP_VALID(n) \
+static int valid_##n(const unsigned char* pw) { \
+    unsigned int upper = 0, digit = 0; \
+    int i; \
+    for (i = 0; i < n; i++) { \
+        upper |= ((unsigned int)(pw[i] - 'A') < 26); \
+        digit |= ((unsigned int)(pw[i] - '0') < 10); \
+    } \
+    return ((unsigned int)(pw[0] - 'a') < 26) & upper & digit; \
+}
+
+// cleanup: md5_final() sets all elements of ctx to 0. the user is
+// interested only in the first n bytes of sgp->pw anyway: 0 the rest.
+#define SGP_KERNEL(method, n) \
+static int method##_##n(struct SGP* sgp) { \
+    unsigned char* pw = &(sgp->pw[0]); \
+    unsigned char* raw = &(sgp->pw[B64_MD5_DIGEST_LENGTH-MD5_DIGEST_LENGTH]); \
+    unsigned int extra = 0; \
+    PROBE2(derive__start, sgp->domain_len, SGP_LENGTH(n)); \
+    chain_##method(sgp); \
+    for (; valid_##n(pw) == 0; extra++) { \
+        round_##method(&(sgp->md5), pw, raw); \
+    } \
+    PROBE2(derive__end, extra, SGP_LENGTH(n)); \
+    byte_zero(pw + n, sizeof(sgp->pw) - n); \
+    return 1; \
+}
+
+#define SGP_LENGTHS(m) \
+    m(4)  m(5)  m(6)  m(7)  m(8)  m(9)  m(10) m(11) m(12) m(13) m(14) \
+    m(15) m(16) m(17) m(18) m(19) m(20) m(21) m(22) m(23) m(24)
+
+#define SGP_KERNEL_MD5(n) SGP_KERNEL(md5, n)
+#define SGP_ROW_VALID(n)  valid_##n,
+#define SGP_ROW_MD5(n)    md5_##n,
+
+SGP_LENGTHS(SGP_VALID)
+SGP_LENGTHS(SGP_KERNEL_MD5)
+
+static const sgp_valid_fn VALID[B64_MD5_DIGEST_LENGTH + 1] = {
+    0, 0, 0, 0, SGP_LENGTHS(SGP_ROW_VALID)
+};
+
+static const sgp_kernel_fn KERNELS[SGP_METHODS][B64_MD5_DIGEST_LENGTH + 1] = {
+    { 0, 0, 0, 0, SGP_LENGTHS(SGP_ROW_MD5) },
+};
+
+sgp_kernel_fn sgp_kernel(int method, size_t len) {
+    if (method < 0 || method >= SGP_METHODS || len > B64_MD5_DIGEST_LENGTH) {
+        return 0;
+    }
+    return KERNELS[method][len];
+}
+
+sgp_valid_fn sgp_valid(size_t len) {
+    return (len <= B64_MD5_DIGEST_LENGTH) ? VALID[len] : 0;
+}
+
+int supergenpass_primed(struct SGP* sgp) {
+
+    sgp_kernel_fn k = sgp_kernel(SGP_MD5, sgp->out_len);
+
+    if (k == 0) {
+        return 0;
+    }
+    return k(sgp);
+}
+
+int supergenpass_lengths(struct SGP* sgp, unsigned int lengths, unsigned char* out) {
+
+    sgp_prime(&(sgp->md5), sgp->pw, sgp->in_len);
+    return supergenpass_lengths_primed(sgp, lengths, out);
+}
+
+// a candidate which is valid for length 'v' is valid for all
+// lengths >= v as well: copies 'pw' to the slot in 'out' of every
+// pending length it is valid for. thus, the longer passwords are
+// done first and a chain runs until the shortest one is valid.
+static void settle(const unsigned char* pw, unsigned int lengths,
+    unsigned int* pending, unsigned char* out) {
+
+    unsigned int hit;
+    size_t v = valid_len(pw);
+    size_t l, off;
+
+    if (v == 0) {
+        return;
+    }
+    hit = *pending & ~(SGP_LENGTH(v) - 1);
+    if (hit == 0) {
+        return;
+    }
+    for (off = 0, l = MIN_PW_LENGTH; l <= B64_MD5_DIGEST_LENGTH; l++) {
+        if (hit & SGP_LENGTH(l)) {
+            byte_copy(out + off, l, pw);
+        }
+        if (lengths & SGP_LENGTH(l)) {
+            off += l;
+        }
+    }
+    *pending &= ~hit;
+}
+
+int supergenpass_lengths_primed(struct SGP* sgp, unsigned int lengths, unsigned char* out) {
+
+    unsigned char* pw = &(sgp->pw[0]);
+    unsigned char* raw = &(sgp->pw[B64_MD5_DIGEST_LENGTH-MD5_DIGEST_LENGTH]);
+    unsigned int pending = lengths;
+    unsigned int extra = 0;
+
+    PROBE2(derive__start, sgp->domain_len, lengths);
+    chain_md5(sgp);
+
+    for (;; extra++) {
+        settle(pw, lengths, &pending, out);
+        if (pending == 0) {
+            break;
+        }
+        round_md5(&(sgp->md5), pw, raw);
+    }
+    PROBE2(derive__end, extra, lengths);
+
+    byte_zero(pw, sizeof(sgp->pw));
+    return 1;
+}
+
+/*------------------------------------------------------------------*\
+
+   the chains of MD5_LANES domains, interleaved (see
+   md5_transform_lanes()). after the initial round every round hashes
+   exactly the 24 bytes of the previous password. each lane keeps its
+   password in the first 24 bytes of its md5 block, the md5 padding
+   for 24 bytes follows and never changes. the digest goes to
+   block[8..23] and is base64-encoded to block[0..23], the same
+   way the 25 byte buffer of 'struct SGP' works.
+\*------------------------------------------------------------------*/
+
+static void lanes_pad(unsigned char* block) {
+    byte_zero(block + B64_MD5_DIGEST_LENGTH, MD5_BLOCK_LENGTH - B64_MD5_DIGEST_LENGTH);
+    block[B64_MD5_DIGEST_LENGTH] = 0x80;
+    block[MD5_BLOCK_LENGTH - 8] = (unsigned char)(B64_MD5_DIGEST_LENGTH * 8);
+}
+
+// the digest in l->state[i] -> base64 -> the password in l->block[i]
+static void lanes_encode(struct SGP_LANES* l, int i) {
+
+    unsigned char* raw = l->block[i] + (B64_MD5_DIGEST_LENGTH - MD5_DIGEST_LENGTH);
+    int j;
+
+    for (j = 0; j < 4; j++) {
+        raw[j*4+0] = (unsigned char)(l->state[i][j]);
+        raw[j*4+1] = (unsigned char)(l->state[i][j] >> 8);
+        raw[j*4+2] = (unsigned char)(l->state[i][j] >> 16);
+        raw[j*4+3] = (unsigned char)(l->state[i][j] >> 24);
+    }
+    base64_encode(l->block[i], raw, MD5_DIGEST_LENGTH, B64_SGP_TABLE);
+}
+
+// puts job[j] on lane 'i'. 'master:' 'domain' is padded into one or
+// two blocks (see md5_short_pad()) which the lane hashes in its next
+// steps. longer domains take the md5_update() way right here and
+// start with their second round.
+static void lanes_load(struct SGP_LANES* l, const md5Context* base, struct SGP_JOB* job, int i, int j) {
+
+    unsigned char* raw = l->block[i] + (B64_MD5_DIGEST_LENGTH - MD5_DIGEST_LENGTH);
+
+    PROBE2(derive__start, job[j].domain_len, job[j].lengths);
+
+    l->job[i] = j;
+    l->pending[i] = job[j].lengths;
+    l->valid[i] = 0;
+    l->len[i] = 0;
+    if ((job[j].lengths & (job[j].lengths - 1)) == 0) { // one length: its kernel
+        for (l->len[i] = MIN_PW_LENGTH; !(job[j].lengths & SGP_LENGTH(l->len[i])); l->len[i]++)
+            ;
+        l->valid[i] = sgp_valid(l->len[i]);
+    }
+    l->first_at[i] = 0;
+    l->first_n[i] = (int)md5_short_pad(l->first[i], base, job[j].domain, job[j].domain_len);
+    l->rounds[i] = 0;
+    byte_copy(l->state[i], sizeof(l->state[i]), base->state);
+
+    if (l->first_n[i] == 0) {
+        byte_copy(&l->md5, sizeof(l->md5), base);
+        md5_update(&l->md5, job[j].domain, job[j].domain_len);
+        md5_final(raw, &l->md5);
+        base64_encode(l->block[i], raw, MD5_DIGEST_LENGTH, B64_SGP_TABLE);
+        lanes_pad(l->block[i]);
+        l->rounds[i] = 1;
+    }
+}
+
+/*------------------------------------------------------------------*\
+   the lanes do not run in lockstep: every md5_transform_lanes() is
+   one step, each lane hashes the next block of its own chain in it,
+   a block of the initial round or the password of the round before.
+   thus, domains with one and with two blocks in the initial round mix
+   freely, and a lane whose chain is done after round 10 (or after
+   the extra rounds for SGP_VALID()) takes the next job in the very
+   next step instead of idling until the slowest lane is done. lanes
+   idle only at the end of the jobs.
+
+   l->steps and l->used count the steps and the lane-blocks which
+   were work, see batch_stats().
+
+\*------------------------------------------------------------------*/
+
+int supergenpass_lanes(struct SGP_LANES* l, const md5Context* base, struct SGP_JOB* job, int n) {
+
+    const unsigned char* p[MD5_LANES];
+    unsigned long long steps = l->steps;
+    unsigned long long used = l->used;
+    int i, j, next, busy;
+
+    md5_init(&l->md5);
+    byte_copy(l->init, sizeof(l->init), l->md5.state);
+
+    for (next = 0, i = 0; i < MD5_LANES; i++) {
+        l->job[i] = -1;
+        if (next < n) {
+            lanes_load(l, base, job, i, next++);
+        }
+    }
+
+    for (;;) {
+        for (busy = 0, i = 0; i < MD5_LANES; i++) {
+            p[i] = l->block[i]; // idle lanes run along on any block
+            if (l->job[i] < 0) {
+                continue;
+            }
+            busy++;
+            if (l->rounds[i] == 0) {
+                p[i] = l->first[i] + (l->first_at[i] * MD5_BLOCK_LENGTH);
+            } else {
+                byte_copy(l->state[i], sizeof(l->state[i]), l->init);
+            }
+        }
+        if (busy == 0) {
+            break;
+        }
+
+        md5_transform_lanes(l->state, p);
+        steps++;
+        used += busy;
+
+        for (i = 0; i < MD5_LANES; i++) {
+            j = l->job[i];
+            if (j < 0) {
+                continue;
+            }
+            if (l->rounds[i] == 0) {
+                if (++l->first_at[i] < l->first_n[i]) {
+                    continue;
+                }
+                lanes_encode(l, i);
+                lanes_pad(l->block[i]);
+            } else {
+                lanes_encode(l, i);
+            }
+            if (++l->rounds[i] < MAX_ROUNDS) {
+                continue;
+            }
+            if (l->valid[i]) {
+                if (l->valid[i](l->block[i]) == 0) {
+                    continue;
+                }
+                byte_copy(job[j].out, l->len[i], l->block[i]);
+                l->pending[i] = 0;
+            } else {
+                settle(l->block[i], job[j].lengths, &l->pending[i], job[j].out);
+                if (l->pending[i] != 0) {
+                    continue;
+                }
+            }
+            PROBE2(derive__end, l->rounds[i] - MAX_ROUNDS, job[j].lengths);
+            l->job[i] = -1;
+            if (next < n) {
+                lanes_load(l, base, job, i, next++);
+            }
+        }
+    }
+
+    byte_zero(l, sizeof(*l));
+    l->steps = steps;
+    l->used = used;
+    return 1;
+}
+
+size_t sgp_lengths_size(unsigned int lengths) {
+
+    size_t l, n = 0;
+    for (l = MIN_PW_LENGTH; l <= B64_MD5_DIGEST_LENGTH; l++) {
+        if (lengths & SGP_LENGTH(l)) {
+            n += l;
+        }
+    }
+    return n;
+}
+
+int parse_lengths(const char* s, size_t n, unsigned int* lengths) {
+
+    size_t i = 0;
+    unsigned long from, to;
+    unsigned int set = 0;
+
+    for (;;) {
+        for (from = 0; i < n && s[i] >= '0' && s[i] <= '9' && from <= B64_MD5_DIGEST_LENGTH; i++) {
+            from = (from * 10) + (s[i] - '0');
+        }
+        to = from;
+        if (i < n && s[i] == '-') {
+            for (i++, to = 0; i < n && s[i] >= '0' && s[i] <= '9' && to <= B64_MD5_DIGEST_LENGTH; i++) {
+                to = (to * 10) + (s[i] - '0');
+            }
+        }
+        if (from < MIN_PW_LENGTH || to > B64_MD5_DIGEST_LENGTH || from > to) {
+            return 0;
+        }
+        for (; from <= to; from++) {
+            set |= SGP_LENGTH(from);
+        }
+        if (i == n) {
+            break;
+        }
+        if (s[i] != ',') {
+            return 0;
+        }
+        i++;
+    }
+
+    *lengths = set;
+    return 1;
+}
+
+int read_pw(int fd, unsigned char* pw, size_t max_len, int shared) {
+
+    int n, r;
+    int tty = posix_isatty(fd);
+
+    PROBE1(io__wait__start, fd);
+    if (tty) {
+        posix_write(2, PROMPT, sizeof(PROMPT)-1); // unbuffered, no fsync()
+        tty_echo(fd, 0);
+        n = (int)posix_read(fd, pw, max_len);
+        tty_echo(fd, 1);
+    } else if (!shared) {
+        n = (int)posix_read(fd, pw, max_len);
+    } else {
+        // several masters follow each other on the same fd (see
+        // batch.h): never read beyond the 'enter'
+        for (n = 0; n < (int)max_len; n++) {
+            r = (int)posix_read(fd, pw + n, 1);
+            if (r <= 0) {
+                if (r == -1) {
+                    n = -1;
+                }
+                break;
+            }
+            if (pw[n] == '\n') {
+                n++;
+                break;
+            }
+        }
+    }
+
+    PROBE2(io__wait__end, fd, n);
+
+    if (n == -1) {
+        return osexit(2, "error: reading pw");
+    }
+
+    // scan backward for lf/cr aka 'the enter'
+    for(; n > 0; n--) {
+        if (!(pw[n-1] == '\n' || pw[n-1] == '\r')) {
+            break;
+        }
+    }
+
+    if (n == 0) {
+        return osexit(2, "error: pw empty");
+    }
+
+    // the given buffer is essentially one byte larger
+    // than the maximum allowed passphrase length.
+    // if we were able to read max_len bytes, the
+    // passphrase exceeds the maximum passphrase length.
+    // a) due to the limit of the design of csgp we won't
+    //    be able to handle more bytes
+    // b) we don't want to write the superflouse bytes to
+    //    stdout where they would become part of the next
+    //    command and thus leak information.
+    // thus, we flush stdin, zero the already read password
+    // and exit with an error
+    if (n == max_len) {
+        if (tty) {
+            discard_fd(fd);
+        }
+        byte_zero(pw, max_len);
+        return osexit(2, "the passphrase is longer than 24 bytes.");
+    }
+
+    return n;
+}
+
+size_t valid_len(const unsigned char* pw) {
+    unsigned int mask = 0;
+    size_t i;
+    if (!(*pw >= 'a' && *pw <= 'z')) {
+        return 0;
+    }
+    for (i = 0; i < B64_MD5_DIGEST_LENGTH; i++) {
+        if ((pw[i] >= 'A') && (pw[i] <= 'Z')) {
+            mask |= 1;
+        } else if ((pw[i] >= '0') && (pw[i] <= '9')) {
+            mask |= 2;
+        }
+        if (mask == 3) {
+            return (i < MIN_PW_LENGTH) ? MIN_PW_LENGTH : i + 1;
+        }
+    }
+    return 0;
+}
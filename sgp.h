@@ -0,0 +1,130 @@
+#ifndef _SGP_H_
+#define _SGP_H_
+
+/*------------------------------------------------------------------*\
+
+       file: sgp.h
+      about: the supergenpass algorithm
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+\*------------------------------------------------------------------*/
+
+#include <stddef.h>
+#include "md5.h"
+#include "base64.h"
+
+enum {
+    MIN_PW_LENGTH         = 4,
+    DEFAULT_PW_LENGTH     = 10,
+    MAX_ROUNDS            = 10,
+    B64_MD5_DIGEST_LENGTH = 24, // base_encded_len(MD5_DIGEST_LENGTH)
+
+    // all passwords of a full set of lengths: 4 + 5 + ... + 24
+    MAX_LENGTHS_SIZE      = 294,
+};
+
+// a set of password lengths: bit 'n' is set for length 'n'
+#define SGP_LENGTH(n) (1u << (n))
+
+// special base64-table to replace
+// '+' -> 9
+// '/' -> 8
+// '=' => A (the padding sign)
+extern const unsigned char B64_SGP_TABLE[BASE64_LUT_LEN];
+
+struct SGP {
+    size_t          in_len;   // length of input password
+    size_t          out_len;  // length of generated password
+    unsigned char   pw[B64_MD5_DIGEST_LENGTH+1]; // see 'notes' in sgp.c
+    md5Context      md5;
+    unsigned char*  domain;
+    size_t          domain_len;
+};
+
+// the hash methods of the derivation, see the kernels in sgp.c
+enum {
+    SGP_MD5 = 0,
+    SGP_METHODS,
+};
+
+// supergenpass_primed() for one (method, length), and the check of a
+// candidate for one length. 0 if there is none.
+typedef int (*sgp_kernel_fn)(struct SGP*);
+typedef int (*sgp_valid_fn)(const unsigned char* pw);
+extern sgp_kernel_fn sgp_kernel(int method, size_t len);
+extern sgp_valid_fn sgp_valid(size_t len);
+
+// derives the password for sgp->domain from the master password
+// in sgp->pw. the result is in the first sgp->out_len bytes of
+// sgp->pw, the rest of sgp->pw is zeroed.
+extern int supergenpass(struct SGP*);
+
+// absorbs 'master' ":" into 'ctx'. the primed context can be
+// reused for any number of domains of the same master.
+extern void sgp_prime(md5Context* ctx, const unsigned char* master, size_t len);
+
+// like supergenpass() but the initial round continues from sgp->md5
+// which was primed via sgp_prime(). sgp->pw is not read.
+extern int supergenpass_primed(struct SGP*);
+
+// one domain for supergenpass_lanes()
+struct SGP_JOB {
+    const unsigned char*    domain;
+    size_t                  domain_len;
+    unsigned int            lengths; // see SGP_LENGTH()
+    unsigned char*          out;     // sgp_lengths_size(lengths) bytes
+};
+
+// the working memory of supergenpass_lanes(), see sgp.c
+struct SGP_LANES {
+    md5Context      md5;
+    unsigned int    init[4];
+    unsigned int    state[MD5_LANES][4];
+    unsigned char   block[MD5_LANES][MD5_BLOCK_LENGTH];
+    unsigned char   first[MD5_LANES][2 * MD5_BLOCK_LENGTH]; // the initial round
+    int             job[MD5_LANES];      // the job of the lane, -1: idle
+    unsigned int    pending[MD5_LANES];  // lengths without a password yet
+    int             first_at[MD5_LANES]; // next block of 'first'
+    int             first_n[MD5_LANES];  // blocks in 'first'
+    int             rounds[MD5_LANES];   // rounds done
+    sgp_valid_fn    valid[MD5_LANES];    // a job with one length: its check
+    size_t          len[MD5_LANES];      // and that length
+
+    // kept over calls: md5_transform_lanes() calls and the lanes of
+    // them which hashed a chain (the rest was idle)
+    unsigned long long steps;
+    unsigned long long used;
+};
+
+// derives the passwords for all lengths in 'lengths' with one hash
+// chain: the chain stops at the first candidate which is valid for
+// each length. the passwords are written to 'out', one after another,
+// shortest first. 'out' needs sgp_lengths_size(lengths) bytes.
+extern int supergenpass_lengths(struct SGP*, unsigned int lengths, unsigned char* out);
+extern int supergenpass_lengths_primed(struct SGP*, unsigned int lengths, unsigned char* out);
+
+// like supergenpass_lengths_primed() for 'n' domains of the same
+// master: MD5_LANES chains run interleaved, a lane takes the next
+// domain as soon as its chain is done. 'base' is primed via
+// sgp_prime().
+extern int supergenpass_lanes(struct SGP_LANES* l, const md5Context* base,
+    struct SGP_JOB* job, int n);
+
+extern size_t sgp_lengths_size(unsigned int lengths);
+
+// parses "10", "8,10,16", "8-12" or "6,8-12" into 'lengths'.
+// returns 0 if 's' is not such a list or a length is out of range.
+extern int parse_lengths(const char* s, size_t n, unsigned int* lengths);
+
+// reads the master password from 'fd' into 'pw'. 'pw' is one byte
+// larger than the longest allowed master, see read_pw() in sgp.c.
+// 'shared': more masters follow on 'fd', they are read one byte at
+// a time up to the 'enter' then, otherwise in one read().
+extern int read_pw(int fd, unsigned char* pw, size_t max_len, int shared);
+
+// returns the shortest length for which 'pw' is valid, 0 if there
+// is none
+extern size_t valid_len(const unsigned char* pw);
+
+#endif
@@ -0,0 +1,100 @@
+/*------------------------------------------------------------------*\
+
+       file: since.c
+      about: reuses the records of a previous -output=bin run
+     author: m. gumz <mg@2hoch5.com>
+    license: see LICENSE.txt
+
+   the first 16 bytes of a record (key, length, method and the tag
+   of the master, see batch.h) are its fingerprint: the same
+   fingerprint means the same password. since_open() maps the old
+   output and puts the fingerprints of all its records into an open
+   addressing hash table. batch_derive() looks up every record and
+   derives only the ones which are not there (new domains, other
+   lengths, other masters).
+
+   the old passwords are copied straight from the mapping of the old
+   file.
+
+\*------------------------------------------------------------------*/
+
+#include "batch.h"
+#include "platform.h"
+#include "le.h"
+
+#include "djb/byte.h"
+
+static size_t fp_hash(const unsigned char* fp) {
+    // the key is a part of a md5 digest already
+    unsigned long long h = get_le(fp, 8) ^ (get_le(fp + 8, 8) * 0x9e3779b97f4a7c15ULL);
+    return (size_t)(h ^ (h >> 32));
+}
+
+/*------------------------------------------------------------------*\
+\*------------------------------------------------------------------*/
+
+int since_open(struct SINCE* s, const char* path) {
+
+    const unsigned char* rec;
+    unsigned long i;
+    size_t h;
+
+    byte_zero(s, sizeof(*s));
+
+    s->file = map_file(path, &s->file_len);
+    if (s->file == 0) {
+        return -1;
+    }
+    if (s->file_len < BIN_HEADER_SIZE || byte_diff(s->file, 4, "CSGP") != 0 ||
+        s->file[4] != BIN_VERSION || s->file[5] != BIN_RECORD_SIZE) {
+        since_close(s);
+        return -1;
+    }
+
+    // a stream has no count in its header, the size of the file
+    // tells it as well
+    s->n = (s->file_len - BIN_HEADER_SIZE) / BIN_RECORD_SIZE;
+
+    for (s->slots = 16; s->slots < s->n * 2; s->slots *= 2)
+        ;
+    s->slot = (unsigned long*)map_shared(s->slots * sizeof(*s->slot));
+    if (s->slot == 0) {
+        since_close(s);
+        return -1;
+    }
+    byte_zero(s->slot, s->slots * sizeof(*s->slot));
+
+    // slot[h] is the index of the record + 1, 0 is an empty slot
+    for (i = 0; i < s->n; i++) {
+        rec = s->file + BIN_HEADER_SIZE + (i * BIN_RECORD_SIZE);
+        for (h = fp_hash(rec) & (s->slots - 1); s->slot[h] != 0; h = (h + 1) & (s->slots - 1))
+            ;
+        s->slot[h] = i + 1;
+    }
+    return 0;
+}
+
+const unsigned char* since_find(const struct SINCE* s, const unsigned char* fp) {
+
+    const unsigned char* rec;
+    size_t h;
+
+    for (h = fp_hash(fp) & (s->slots - 1); s->slot[h] != 0; h = (h + 1) & (s->slots - 1)) {
+        rec = s->file + BIN_HEADER_SIZE + ((s->slot[h] - 1) * BIN_RECORD_SIZE);
+        if (byte_equal(rec, BIN_FP_SIZE, fp)) {
+            return rec + BIN_FP_SIZE;
+        }
+    }
+    return 0;
+}
+
+void since_close(struct SINCE* s) {
+
+    if (s->slot) {
+        unmap_shared(s->slot, s->slots * sizeof(*s->slot));
+    }
+    if (s->file) {
+        unmap_file(s->file, s->file_len);
+    }
+    byte_zero(s, sizeof(*s));
+}